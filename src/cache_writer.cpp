@@ -0,0 +1,29 @@
+#include "include/cache_writer.h"
+
+#include <QDebug>
+
+/**
+ * @brief Construct a new Cache_Writer::Cache_Writer object
+ *
+ * @param _dataset 数据表，运行期间只读取，不能被修改。
+ * @param _source_path 数据表的csv文件路径。
+ * @param _key 加载前取得的源文件标识，见Dataset_Loader::source_key。
+ * @param parent
+ */
+Cache_Writer::Cache_Writer(const Dataset &_dataset, const QString &_source_path, const Cache_source_key &_key,
+                           QObject *parent):
+    QThread(parent), dataset(_dataset), source_path(_source_path), key(_key){
+}
+
+/**
+ * @brief 后台线程的入口。
+ *
+ */
+void Cache_Writer::run(){
+    const bool saved = save_dataset_cache(source_path, key, dataset, [this](){
+        return !isInterruptionRequested();
+    });
+    if (!saved && !isInterruptionRequested()){
+        qDebug() << "fail to write" << dataset_cache_path(source_path);
+    }
+}
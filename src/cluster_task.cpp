@@ -0,0 +1,135 @@
+#include "include/cluster_task.h"
+#include "include/needed_algo/dbscan.hpp"
+
+namespace {
+
+// 发出进度和预览信号的最小间隔，毫秒
+const qint64 progress_interval = 50;
+const qint64 preview_interval = 300;
+
+} // namespace
+
+/**
+ * @brief Construct a new Cluster_Task::Cluster_Task object
+ *
+ * @param method 聚类方法
+ * @param _samples 样本，每行为一个样本。由任务持有，运行期间表格可以继续修改。
+ * @param parent
+ */
+Cluster_Task::Cluster_Task(Cluster_method method, Eigen::MatrixXf &&_samples, QObject *parent):
+    QThread(parent), cluster_method(method), samples(std::move(_samples)){
+}
+
+/**
+ * @brief 取走最近一次的分组预览，没有新的预览时返回空vector。
+ *
+ * @return std::vector<int>
+ */
+std::vector<int> Cluster_Task::take_preview(){
+    QMutexLocker locker(&mutex);
+    std::vector<int> taken;
+    taken.swap(preview);
+    return taken;
+}
+
+/**
+ * @brief 报告进度。距上次发出超过progress_interval时才发出信号。
+ *
+ * @return 是否继续运行，请求取消时为false
+ */
+bool Cluster_Task::report(int done, int total, const QString &text){
+    if (isInterruptionRequested()){
+        return false;
+    }
+    QMutexLocker locker(&mutex);
+    if (timer_progress.elapsed() >= progress_interval){
+        timer_progress.restart();
+        emit progress(done, total, text);
+    }
+    return true;
+}
+
+/**
+ * @brief K-means每轮的进度回调。第0次运行的分组每隔preview_interval复制一份作为预览。
+ * 并发的各次运行分别记下已完成的轮数，进度为各次之和，不会在各次运行之间来回跳动。
+ * 惯性需要再遍历一次样本，只在发出进度信号时计算。
+ *
+ */
+bool Cluster_Task::report_kmeans(const KMeansProgress &state){
+    if (isInterruptionRequested()){
+        return false;
+    }
+
+    QMutexLocker locker(&mutex);
+    if (state.labels && state.restart == 0 && timer_preview.elapsed() >= preview_interval){
+        timer_preview.restart();
+        preview = *state.labels;
+        emit preview_ready();
+    }
+
+    restart_iterations[state.restart] = state.iteration;
+    if (timer_progress.elapsed() < progress_interval){
+        return true;
+    }
+    timer_progress.restart();
+    int done = 0;
+    for (int iterations : restart_iterations){
+        done += iterations;
+    }
+    const int total = kmeans_options.maxIter * int(restart_iterations.size());
+    locker.unlock();
+
+    QString text;
+    if (cluster_method == Cluster_method::minibatch){
+        text = QString("Step %1, inertia %2").arg(state.iteration).arg(state.inertia(), 0, 'g', 6);
+    }
+    else{
+        text = QString("Restart %1, iteration %2, inertia %3")
+                   .arg(state.restart + 1).arg(state.iteration).arg(state.inertia(), 0, 'g', 6);
+    }
+    emit progress(std::min(done, total), total, text);
+    return true;
+}
+
+/**
+ * @brief 后台线程的入口。
+ *
+ */
+void Cluster_Task::run(){
+    timer_progress.start();
+    timer_preview.start();
+    const long long cnt_samples = samples.rows();
+
+    try{
+        if (cluster_method == Cluster_method::dbscan){
+            labels = dbscanParallel(samples, dbscan_epsilon, dbscan_minPts, 0, [&](long long done, long long total){
+                long long pass = std::min<long long>(3, done / std::max(1LL, cnt_samples) + 1);
+                QString text = QString("Pass %1/3, %2 of %3 points")
+                                   .arg(pass)
+                                   .arg(done - (pass - 1) * cnt_samples)
+                                   .arg(cnt_samples);
+                return report(int(done * 1000 / std::max(1LL, total)), 1000, text);
+            });
+        }
+        else{
+            KMeansOptions options = kmeans_options;
+            restart_iterations.assign(cluster_method == Cluster_method::minibatch ? 1 : std::max(1, options.nInit), 0);
+            options.onProgress = [this](const KMeansProgress &state){
+                return report_kmeans(state);
+            };
+            KMeansResult result = cluster_method == Cluster_method::minibatch
+                                      ? kmeansMiniBatch(samples, options)
+                                      : kmeans(samples, options);
+            labels = std::move(result.labels);
+            cnt_iterations = result.iterations;
+            final_inertia = result.inertia;
+            is_converged = result.converged;
+        }
+        success = true;
+    }
+    catch (const TaskCancelled &){
+    }
+    catch (const std::exception &e){
+        error = e.what();
+    }
+}
@@ -0,0 +1,205 @@
+#include "include/column_profile.h"
+#include "include/dataset.h"
+#include "include/needed_algo/hyperloglog.hpp"
+
+#include <cstdlib>
+
+namespace {
+
+// 每个并行任务最少处理的行数
+const size_t profile_chunk_rows = 1 << 16;
+// 每个线程平均分到的任务数。任务越多负载越均衡，但每个任务各有一份HyperLogLog寄存器和KLL sketch
+const size_t profile_tasks_per_thread = 4;
+
+/**
+ * @brief 取一列中[begin, begin + n)的值。float32列直接返回缓冲区中的位置，
+ * int32列转换到out中，空值为NaN。
+ *
+ */
+const float *column_block(const Column &column, size_t begin, size_t n, float *out){
+    if (column.type == Column_type::float32){
+        return column.floats.data() + begin;
+    }
+    for (size_t i = 0; i < n; i ++){
+        const int32_t value = column.ints[begin + i];
+        out[i] = value == Dataset::null_int ? NAN : float(value);
+    }
+    return out;
+}
+
+/**
+ * @brief profile_bins中与bins最接近的约数，距离相同时取较小者。
+ *
+ */
+int nearest_divisor(int bins){
+    int best = 1;
+    for (int divisor = 2; divisor <= profile_bins; divisor ++){
+        if (profile_bins % divisor == 0 && std::abs(divisor - bins) < std::abs(best - bins)){
+            best = divisor;
+        }
+    }
+    return best;
+}
+
+} // namespace
+
+/**
+ * @brief 按规则选择直方图的组数。Scott规则使用标准差，Freedman–Diaconis规则使用sketch估计的四分位距。
+ * 结果取profile_bins中最接近的约数，合并细分直方图时每组含相同数量的细分组，条形等宽可比。
+ *
+ * @param rule 规则。
+ * @param fixed_bins rule为BinRule::fixed时的组数，同样取最接近的约数。
+ * @return int 组数，为profile_bins的约数。
+ */
+int Column_Profile::bin_count(BinRule rule, int fixed_bins) const{
+    double iqr = 0;
+    if (rule == BinRule::freedmanDiaconis && !quantiles.empty()){
+        const std::vector<float> quartiles = quantiles.quantiles({0.25, 0.75});
+        iqr = quartiles[1] - quartiles[0];
+    }
+    const int bins = histogramBins(rule, moments.count, moments.stddev(), iqr, moments.min, moments.max, fixed_bins);
+    return nearest_divisor(bins);
+}
+
+/**
+ * @brief 由细分直方图合并出按规则选择组数的直方图。
+ *
+ * @param rule 规则。
+ * @param fixed_bins rule为BinRule::fixed时的组数。
+ * @return Histogram 未统计时为空。
+ */
+Histogram Column_Profile::binned(BinRule rule, int fixed_bins) const{
+    if (!valid){
+        return {};
+    }
+    return histogramRebin(fine_histogram, moments.min, moments.max, bin_count(rule, fixed_bins));
+}
+
+/**
+ * @brief 统计指定的数值列。每列按行分为若干段，各段作为并行任务：
+ * 第一遍求矩、最值、HyperLogLog和KLL sketch，合并后得到各列的范围，第二遍统计直方图。
+ * 只读取columns，可以在后台线程中调用，期间不能修改这些列。
+ *
+ * @param columns 各列。
+ * @param targets 要统计的列，不能是dictionary列。
+ * @param rows 行数。
+ * @param threads 线程数，0表示全部硬件线程。
+ * @param keep_going 不为空时在每段的每块之前调用（可能在多个线程中同时调用），返回false则取消并抛出TaskCancelled。
+ * @return std::vector<Column_Profile> 与targets对应的统计结果。
+ */
+std::vector<Column_Profile> compute_profiles(const std::vector<Column> &columns, const std::vector<size_t> &targets,
+                                             size_t rows, size_t threads, const std::function<bool()> &keep_going){
+    std::vector<Column_Profile> profiles(targets.size());
+    if (targets.empty()){
+        return profiles;
+    }
+
+//    列数少、行数多时把每列分为多段，使任务数足够所有线程使用
+    const size_t cnt_threads = resolveThreads(threads, SIZE_MAX);
+    const size_t wanted_chunks = (cnt_threads * profile_tasks_per_thread + targets.size() - 1) / targets.size();
+    const size_t chunks_per_col = std::max<size_t>(1, std::min(wanted_chunks, (rows + profile_chunk_rows - 1) / profile_chunk_rows));
+    const size_t chunk_rows = std::max<size_t>(1, (rows + chunks_per_col - 1) / chunks_per_col);
+    const size_t cnt_tasks = targets.size() * chunks_per_col;
+
+    std::vector<Moments> moments(cnt_tasks);
+    std::vector<HyperLogLog> sketches(cnt_tasks);
+    std::vector<KllSketch> quantiles;
+    quantiles.reserve(cnt_tasks);
+    for (size_t task = 0; task < cnt_tasks; task ++){
+        quantiles.emplace_back(kllDefaultK, task % chunks_per_col);
+    }
+    auto check_cancelled = [&](){
+        if (keep_going && !keep_going()){
+            throw TaskCancelled();
+        }
+    };
+    parallelFor(cnt_tasks, threads, [&](size_t task){
+        const Column &column = columns[targets[task / chunks_per_col]];
+        const size_t end = std::min(rows, (task % chunks_per_col + 1) * chunk_rows);
+        std::vector<float> converted(momentsBlockSize);
+        Eigen::ArrayXd buffer(momentsBlockSize);
+        for (size_t begin = (task % chunks_per_col) * chunk_rows; begin < end; begin += momentsBlockSize){
+            check_cancelled();
+            const size_t n = std::min(momentsBlockSize, end - begin);
+            const float *values = column_block(column, begin, n, converted.data());
+            moments[task].merge(momentsOfBlock(values, n, buffer));
+            for (size_t i = 0; i < n; i ++){
+                sketches[task].add(values[i]);
+                quantiles[task].add(values[i]);
+            }
+        }
+    });
+
+    for (size_t t = 0; t < targets.size(); t ++){
+        const Column &column = columns[targets[t]];
+        Column_Profile &profile = profiles[t];
+        HyperLogLog sketch;
+        for (size_t chunk = 0; chunk < chunks_per_col; chunk ++){
+            profile.moments.merge(moments[t * chunks_per_col + chunk]);
+            sketch.merge(sketches[t * chunks_per_col + chunk]);
+            profile.quantiles.merge(quantiles[t * chunks_per_col + chunk]);
+        }
+        profile.null_count = column.null_count;
+        profile.distinct = sketch.estimate();
+    }
+
+//    每个任务有自己的计数数组，组号用SIMD按块计算
+    std::vector<std::vector<long long>> counts(cnt_tasks);
+    parallelFor(cnt_tasks, threads, [&](size_t task){
+        const Column &column = columns[targets[task / chunks_per_col]];
+        const Moments &range = profiles[task / chunks_per_col].moments;
+        counts[task].assign(profile_bins, 0);
+//        全为空值的列没有范围，直方图为全0
+        if (range.count == 0){
+            return;
+        }
+        HistogramCounter counter(profile_bins, range.min, range.max);
+        const size_t end = std::min(rows, (task % chunks_per_col + 1) * chunk_rows);
+        std::vector<float> converted(histogramBlockSize);
+        for (size_t begin = (task % chunks_per_col) * chunk_rows; begin < end; begin += histogramBlockSize){
+            check_cancelled();
+            const size_t n = std::min(histogramBlockSize, end - begin);
+            counter.add(column_block(column, begin, n, converted.data()), n);
+        }
+        counter.addTo(counts[task]);
+    });
+
+    for (size_t t = 0; t < targets.size(); t ++){
+        Column_Profile &profile = profiles[t];
+        profile.fine_histogram.assign(profile_bins, 0);
+        for (size_t chunk = 0; chunk < chunks_per_col; chunk ++){
+            const std::vector<long long> &count = counts[t * chunks_per_col + chunk];
+            for (int bin = 0; bin < profile_bins; bin ++){
+                profile.fine_histogram[bin] += count[bin];
+            }
+        }
+        profile.valid = true;
+    }
+    return profiles;
+}
+
+/**
+ * @brief 尚未统计的数值列。
+ *
+ */
+std::vector<size_t> unprofiled_columns(const std::vector<Column> &columns){
+    std::vector<size_t> targets;
+    for (size_t col = 0; col < columns.size(); col ++){
+        if (!columns[col].profile.valid && columns[col].type != Column_type::dictionary){
+            targets.push_back(col);
+        }
+    }
+    return targets;
+}
+
+/**
+ * @brief 统计各个尚未统计的数值列，结果写入每列的profile。见compute_profiles。
+ *
+ */
+void profile_columns(std::vector<Column> &columns, size_t rows, size_t threads){
+    const std::vector<size_t> targets = unprofiled_columns(columns);
+    std::vector<Column_Profile> profiles = compute_profiles(columns, targets, rows, threads);
+    for (size_t t = 0; t < targets.size(); t ++){
+        columns[targets[t]].profile = std::move(profiles[t]);
+    }
+}
@@ -0,0 +1,688 @@
+#include "include/csv_parser.h"
+#include "include/needed_algo/parallel.hpp"
+
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+
+// x86-64总有SSE2。AVX2版本用target属性单独编译，不需要-mavx2：
+// 编译时已启用AVX2则直接使用，否则在运行时检测CPU后选用
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CSV_SIMD_SSE2
+#if defined(__AVX2__) || defined(__GNUC__) || defined(_MSC_VER)
+#define CSV_SIMD_AVX2
+#endif
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(__GNUC__) && !defined(__AVX2__)
+#define CSV_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CSV_TARGET_AVX2
+#endif
+
+namespace {
+
+// 用于推断列类型的样本行数
+const size_t cnt_sample_rows = 1024;
+
+// 并行解析时每块的最小字节数，避免小文件被切得过碎
+const size_t min_chunk_bytes = 1 << 20;
+
+// 每个线程平均分到的块数，块数多于线程数以均衡负载
+const size_t chunks_per_thread = 4;
+
+inline int count_trailing_zeros(uint32_t mask){
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+inline int count_bits(uint32_t mask){
+#if defined(_MSC_VER)
+    return __popcnt(mask);
+#else
+    return __builtin_popcount(mask);
+#endif
+}
+
+#if defined(CSV_SIMD_AVX2)
+/**
+ * @brief CPU是否支持AVX2（以及操作系统是否保存YMM寄存器）。只检测一次。
+ *
+ */
+bool avx2_enabled(){
+#if defined(__AVX2__)
+    return true;
+#elif defined(_MSC_VER)
+    static const bool enabled = [](){
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7){
+            return false;
+        }
+        __cpuid(info, 1);
+        const bool os_saves_ymm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        return os_saves_ymm && (info[1] & (1 << 5)) != 0;
+    }();
+    return enabled;
+#else
+    static const bool enabled = [](){
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+    }();
+    return enabled;
+#endif
+}
+
+/**
+ * @brief for_each_separator的AVX2部分：每次比较32字节，p停在剩余不足32字节处。
+ *
+ */
+template<typename F>
+CSV_TARGET_AVX2 void for_each_separator_avx2(const char *&p, const char *end, F &f){
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    for (; end - p >= 32; p += 32){
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        const uint32_t mask_newline = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline));
+        uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, comma)) | mask_newline;
+        while (mask){
+            const int i = count_trailing_zeros(mask);
+            f(p + i, ((mask_newline >> i) & 1) != 0);
+            mask &= mask - 1;
+        }
+    }
+}
+
+/**
+ * @brief count_newlines的AVX2部分，p停在剩余不足32字节处。
+ *
+ */
+CSV_TARGET_AVX2 size_t count_newlines_avx2(const char *&p, const char *end){
+    size_t count = 0;
+    const __m256i newline = _mm256_set1_epi8('\n');
+    for (; end - p >= 32; p += 32){
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        count += count_bits(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline)));
+    }
+    return count;
+}
+#endif
+
+/**
+ * @brief 对[begin, end)中的每个逗号和换行符调用f(位置, 是否为换行符)。
+ * 每次比较一个SIMD宽度的字节，得到分隔符的位掩码后逐位处理：支持AVX2时先每次32字节，
+ * 再用SSE2处理剩余的16字节，最后逐个比较。
+ *
+ */
+template<typename F>
+inline void for_each_separator(const char *begin, const char *end, F &&f){
+    const char *p = begin;
+#if defined(CSV_SIMD_AVX2)
+    if (avx2_enabled()){
+        for_each_separator_avx2(p, end, f);
+    }
+#endif
+#if defined(CSV_SIMD_SSE2)
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; end - p >= 16; p += 16){
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        const uint32_t mask_newline = _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+        uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, comma)) | mask_newline;
+        while (mask){
+            const int i = count_trailing_zeros(mask);
+            f(p + i, ((mask_newline >> i) & 1) != 0);
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; p < end; p++){
+        if (*p == ','){
+            f(p, false);
+        }
+        else if (*p == '\n'){
+            f(p, true);
+        }
+    }
+}
+
+/**
+ * @brief 统计换行符的数量，用于预先分配列缓冲区。
+ *
+ */
+size_t count_newlines(const char *begin, const char *end){
+    size_t count = 0;
+    const char *p = begin;
+#if defined(CSV_SIMD_AVX2)
+    if (avx2_enabled()){
+        count += count_newlines_avx2(p, end);
+    }
+#endif
+#if defined(CSV_SIMD_SSE2)
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; end - p >= 16; p += 16){
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        count += count_bits(_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline)));
+    }
+#endif
+    for (; p < end; p++){
+        count += *p == '\n';
+    }
+    return count;
+}
+
+/**
+ * @brief 返回第cnt_lines行之后的位置。不足cnt_lines行时返回end。
+ *
+ */
+const char *skip_lines(const char *begin, const char *end, size_t cnt_lines){
+    while (cnt_lines > 0 && begin < end){
+        const void *newline = std::memchr(begin, '\n', end - begin);
+        if (!newline){
+            return end;
+        }
+        begin = static_cast<const char *>(newline) + 1;
+        cnt_lines--;
+    }
+    return begin;
+}
+
+/**
+ * @brief 去掉字段首尾的空白字符（包括行尾的\r）。
+ *
+ */
+inline void trim(const char *&begin, const char *&end){
+    while (begin < end && (*begin == ' ' || *begin == '\t')){
+        begin++;
+    }
+    while (end > begin && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')){
+        end--;
+    }
+}
+
+/**
+ * @brief 依次处理每一行的字段。on_field(列序号, 字段首, 字段尾)接收去掉空白后的字段，
+ * on_row(字段数)在每个非空行结束时调用。
+ *
+ */
+template<typename Field, typename Row>
+void for_each_record(const char *begin, const char *end, Field &&on_field, Row &&on_row){
+    size_t col = 0;
+    const char *field = begin;
+    auto emit_field = [&](const char *field_end){
+        const char *b = field;
+        const char *e = field_end;
+        trim(b, e);
+        on_field(col, b, e);
+    };
+    for_each_separator(begin, end, [&](const char *p, bool is_newline){
+        if (is_newline){
+//            跳过空行
+            const bool is_empty = col == 0 && (p == field || (p == field + 1 && *field == '\r'));
+            if (!is_empty){
+                emit_field(p);
+                on_row(col + 1);
+            }
+            col = 0;
+        }
+        else {
+            emit_field(p);
+            col++;
+        }
+        field = p + 1;
+    });
+    if (field < end && !(col == 0 && end == field + 1 && *field == '\r')){
+        emit_field(end);
+        on_row(col + 1);
+    }
+}
+
+/**
+ * @brief 解析不带指数的短小数。尾数不超过2^24且小数位不超过10位时，
+ * 尾数和10的幂都能用float精确表示，一次除法即得到正确舍入的结果。
+ *
+ * @return 是否适用快速路径。不适用时应交给std::from_chars。
+ */
+inline bool parse_decimal_fast(const char *begin, const char *end, float &out){
+    static const float powers_of_ten[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+    const bool negative = begin < end && *begin == '-';
+    if (negative){
+        begin++;
+    }
+    uint32_t mantissa = 0;
+    int cnt_digits = 0;
+    int cnt_fraction = 0;
+    bool has_point = false;
+    for (const char *p = begin; p < end; p++){
+        const unsigned digit = static_cast<unsigned>(*p - '0');
+        if (digit < 10){
+            if (cnt_digits >= 9){
+                return false;
+            }
+            mantissa = mantissa * 10 + digit;
+            cnt_digits += mantissa != 0;
+            cnt_fraction += has_point;
+        }
+        else if (*p == '.' && !has_point){
+            has_point = true;
+        }
+        else {
+            return false;
+        }
+    }
+    if (end - begin == has_point || mantissa > (1u << 24) || cnt_fraction > 10){
+        return false;
+    }
+    float value = static_cast<float>(mantissa);
+    if (cnt_fraction > 0){
+        value /= powers_of_ten[cnt_fraction];
+    }
+    out = negative ? -value : value;
+    return true;
+}
+
+/**
+ * @brief 将字段解析为数值。benign 良性记为0，malignant 恶性记为1。
+ *
+ * @return 字段是否为数值。
+ */
+inline bool parse_number(const char *begin, const char *end, float &out){
+    if (end - begin == 1){
+        if (*begin == 'B'){
+            out = 0;
+            return true;
+        }
+        if (*begin == 'M'){
+            out = 1;
+            return true;
+        }
+    }
+    if (parse_decimal_fast(begin, end, out)){
+        return true;
+    }
+    if (begin < end && *begin == '+'){
+        begin++;
+    }
+    auto result = std::from_chars(begin, end, out);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+/**
+ * @brief 将字段解析为整数。只接受可选的负号和数字。
+ *
+ * @return 字段是否为int32范围内的整数。
+ */
+inline bool parse_int(const char *begin, const char *end, int32_t &out){
+    if (end - begin == 1){
+        if (*begin == 'B'){
+            out = 0;
+            return true;
+        }
+        if (*begin == 'M'){
+            out = 1;
+            return true;
+        }
+    }
+    auto result = std::from_chars(begin, end, out);
+    return result.ec == std::errc() && result.ptr == end && out != Dataset::null_int;
+}
+
+/**
+ * @brief 用前若干行推断列类型：数值多于文本则为数值列，全部为整数则为int32列。
+ *
+ */
+void infer_types(const char *begin, const char *end, std::vector<Column> &columns){
+    const size_t cnt_cols = columns.size();
+    std::vector<size_t> cnt_numeric(cnt_cols, 0);
+    std::vector<size_t> cnt_text(cnt_cols, 0);
+    std::vector<bool> all_integral(cnt_cols, true);
+
+    const char *sample_end = skip_lines(begin, end, cnt_sample_rows);
+    for_each_record(begin, sample_end, [&](size_t col, const char *b, const char *e){
+        if (col >= cnt_cols || b == e){
+            return;
+        }
+        float value;
+        int32_t ivalue;
+        if (parse_int(b, e, ivalue)){
+            cnt_numeric[col]++;
+        }
+        else if (parse_number(b, e, value)){
+            cnt_numeric[col]++;
+            all_integral[col] = false;
+        }
+        else {
+            cnt_text[col]++;
+        }
+    }, [](size_t){});
+
+    for (size_t col = 0; col < cnt_cols; col ++){
+        Column &column = columns[col];
+        if (cnt_text[col] > cnt_numeric[col]){
+            column.type = Column_type::dictionary;
+        }
+        else if (all_integral[col] && cnt_numeric[col] > 0){
+            column.type = Column_type::int32;
+        }
+        else {
+            column.type = Column_type::float32;
+        }
+    }
+}
+
+/**
+ * @brief 将[begin, end)中的数据行逐字段追加到列缓冲区。
+ *
+ * @return size_t 解析的行数。
+ */
+size_t parse_rows(const char *begin, const char *end, std::vector<Column> &columns){
+    const size_t cnt_cols = columns.size();
+
+//    预先分配缓冲区
+    const size_t cnt_rows_estimated = count_newlines(begin, end) + 1;
+    for (Column &column : columns){
+        if (column.type == Column_type::float32){
+            column.floats.reserve(cnt_rows_estimated);
+        }
+        else {
+            column.ints.reserve(cnt_rows_estimated);
+        }
+    }
+
+//    dictionary列的取值到编码，键指向输入缓冲区
+    std::vector<std::unordered_map<std::string_view, int32_t>> codes(cnt_cols);
+
+    auto append = [&](size_t col, const char *b, const char *e){
+        Column &column = columns[col];
+        if (b == e){
+            column.null_count++;
+            if (column.type == Column_type::float32){
+                column.floats.push_back(NAN);
+            }
+            else {
+                column.ints.push_back(Dataset::null_int);
+            }
+            return;
+        }
+        switch (column.type){
+        case Column_type::int32: {
+            int32_t ivalue;
+            if (parse_int(b, e, ivalue)){
+                column.ints.push_back(ivalue);
+                return;
+            }
+            float value;
+            if (!parse_number(b, e, value)){
+                column.null_count++;
+                column.ints.push_back(Dataset::null_int);
+                return;
+            }
+            promote_to_float(column);
+            column.floats.push_back(value);
+            return;
+        }
+        case Column_type::float32: {
+            float value;
+            if (!parse_number(b, e, value)){
+                column.null_count++;
+                value = NAN;
+            }
+            column.floats.push_back(value);
+            return;
+        }
+        case Column_type::dictionary: {
+            auto inserted = codes[col].emplace(std::string_view(b, e - b), int32_t(column.dict.size()));
+            if (inserted.second){
+                column.dict.emplace_back(b, e);
+            }
+            column.ints.push_back(inserted.first->second);
+            return;
+        }
+        }
+    };
+
+    size_t cnt_rows = 0;
+    for_each_record(begin, end, [&](size_t col, const char *b, const char *e){
+        if (col < cnt_cols){
+            append(col, b, e);
+        }
+    }, [&](size_t cnt_fields){
+//        缺少的字段记为空值
+        for (size_t col = cnt_fields; col < cnt_cols; col ++){
+            append(col, nullptr, nullptr);
+        }
+        cnt_rows++;
+    });
+    return cnt_rows;
+}
+
+/**
+ * @brief 将[begin, end)切分为至多cnt_chunks块，每块的边界都在换行符之后。
+ *
+ * @return std::vector<const char *> 各块的边界，首尾分别为begin和end。
+ */
+std::vector<const char *> split_chunks(const char *begin, const char *end, size_t cnt_chunks){
+    std::vector<const char *> bounds{begin};
+    for (size_t i = 1; i < cnt_chunks; i ++){
+        const char *p = begin + (end - begin) * i / cnt_chunks;
+        p = skip_lines(std::max(p, bounds.back()), end, 1);
+        if (p > bounds.back() && p < end){
+            bounds.push_back(p);
+        }
+    }
+    bounds.push_back(end);
+    return bounds;
+}
+
+/**
+ * @brief 按行序拼接各块解析出的列。某块中被提升为float32的列在所有块中都提升，
+ * dictionary列的编码按首次出现的顺序重新编号，与串行解析的结果一致。
+ *
+ * @param chunks 每块的列，列名和列数相同。拼接后块中的缓冲区被释放。
+ * @param threads 线程数，各列并行拼接。
+ * @return std::vector<Column>
+ */
+std::vector<Column> stitch_chunks(std::vector<std::vector<Column>> &chunks, size_t threads){
+    const size_t cnt_cols = chunks[0].size();
+    std::vector<Column> columns(cnt_cols);
+
+    parallelFor(cnt_cols, threads, [&](size_t col){
+        Column &column = columns[col];
+        column.name = chunks[0][col].name;
+        column.type = chunks[0][col].type;
+
+        bool any_float = false;
+        size_t cnt_rows = 0;
+        for (auto &chunk : chunks){
+            const Column &part = chunk[col];
+            any_float = any_float || part.type == Column_type::float32;
+            cnt_rows += part.type == Column_type::float32 ? part.floats.size() : part.ints.size();
+        }
+        if (column.type == Column_type::int32 && any_float){
+            for (auto &chunk : chunks){
+                if (chunk[col].type == Column_type::int32){
+                    promote_to_float(chunk[col]);
+                }
+            }
+            column.type = Column_type::float32;
+        }
+
+        if (column.type == Column_type::float32){
+            column.floats.reserve(cnt_rows);
+        }
+        else {
+            column.ints.reserve(cnt_rows);
+        }
+
+//        dictionary列的全局编码，键指向各块自己的取值表
+        std::unordered_map<std::string_view, int32_t> codes;
+        for (auto &chunk : chunks){
+            Column &part = chunk[col];
+            column.null_count += part.null_count;
+            switch (column.type){
+            case Column_type::float32:
+                column.floats.insert(column.floats.end(), part.floats.begin(), part.floats.end());
+                part.floats = std::vector<float>();
+                break;
+            case Column_type::int32:
+                column.ints.insert(column.ints.end(), part.ints.begin(), part.ints.end());
+                part.ints = std::vector<int32_t>();
+                break;
+            case Column_type::dictionary: {
+                std::vector<int32_t> remap(part.dict.size());
+                for (size_t code = 0; code < part.dict.size(); code ++){
+                    auto inserted = codes.emplace(part.dict[code], int32_t(column.dict.size()));
+                    if (inserted.second){
+                        column.dict.push_back(part.dict[code]);
+                    }
+                    remap[code] = inserted.first->second;
+                }
+                for (int32_t code : part.ints){
+                    column.ints.push_back(code == Dataset::null_int ? code : remap[code]);
+                }
+                part.ints = std::vector<int32_t>();
+                break;
+            }
+            }
+        }
+    });
+    return columns;
+}
+
+/**
+ * @brief 并行解析[begin, end)中的数据行：按换行符切分为多块，各块在线程池上解析，再按行序拼接。
+ *
+ * @param columns 列名和列类型，解析后写入数据。
+ * @return size_t 解析的行数。
+ */
+size_t parse_range(const char *begin, const char *end, std::vector<Column> &columns, size_t threads){
+    const size_t cnt_chunks = std::min(resolveThreads(threads, SIZE_MAX) * chunks_per_thread,
+                                       std::max<size_t>(1, (end - begin) / min_chunk_bytes));
+    const auto bounds = split_chunks(begin, end, cnt_chunks);
+    if (bounds.size() <= 2){
+        return parse_rows(begin, end, columns);
+    }
+
+    std::vector<std::vector<Column>> chunks(bounds.size() - 1, columns);
+    std::vector<size_t> cnt_chunk_rows(chunks.size());
+    parallelFor(chunks.size(), threads, [&](size_t chunk){
+        cnt_chunk_rows[chunk] = parse_rows(bounds[chunk], bounds[chunk + 1], chunks[chunk]);
+    });
+    size_t cnt_rows = 0;
+    for (size_t cnt : cnt_chunk_rows){
+        cnt_rows += cnt;
+    }
+    columns = stitch_chunks(chunks, threads);
+    return cnt_rows;
+}
+
+} // namespace
+
+/**
+ * @brief Construct a new Csv_reader::Csv_reader object
+ * 读取表头，并用前若干行推断列类型。
+ *
+ * @param data csv文本，通常是内存映射的文件，需在读取结束前保持有效。
+ * @param size 文本的字节数。
+ * @param _threads 线程数，0表示使用全部硬件线程。
+ */
+Csv_reader::Csv_reader(const char *data, size_t size, size_t _threads):
+    begin(data), position(data), end(data + size), threads(_threads){
+//    跳过UTF-8 BOM
+    if (size >= 3 && static_cast<unsigned char>(data[0]) == 0xEF
+        && static_cast<unsigned char>(data[1]) == 0xBB
+        && static_cast<unsigned char>(data[2]) == 0xBF){
+        position += 3;
+    }
+
+//    表头
+    const char *header_end = skip_lines(position, end, 1);
+    for_each_record(position, header_end, [&](size_t, const char *b, const char *e){
+        Column column;
+        column.name.assign(b, e);
+        schema.push_back(std::move(column));
+    }, [](size_t){});
+    position = header_end;
+
+    if (schema.empty()){
+        position = end;
+        return;
+    }
+    infer_types(position, end, schema);
+}
+
+/**
+ * @brief 解析下一批数据行。批的末尾对齐到换行符，因此实际字节数可能略多于max_bytes。
+ * 各批的dictionary列有各自的取值表，int32列也可能在某一批中被提升为float32，
+ * 用Dataset::append拼接即可得到与一次性解析相同的结果。
+ *
+ * @param max_bytes 本批最多解析的字节数。
+ * @return Dataset 本批的数据行，列与表头一致。
+ */
+Dataset Csv_reader::next(size_t max_bytes){
+    const char *batch_end = end;
+    if (max_bytes < size_t(end - position)){
+        batch_end = skip_lines(position + max_bytes, end, 1);
+    }
+
+    std::vector<Column> columns = schema;
+    const size_t cnt_rows = parse_range(position, batch_end, columns, threads);
+    position = batch_end;
+    return Dataset(std::move(columns), cnt_rows);
+}
+
+/**
+ * @brief 解析csv文本，生成列式数据表。第一行为表头，列类型由前若干行推断。
+ * 分隔符和换行符用SIMD查找，数值用std::from_chars直接写入列缓冲区。
+ * 文本按换行符切分为多块，各块在线程池上并行解析（包括B/M的映射），再按行序拼接。
+ *
+ * @param data csv文本，通常是内存映射的文件。
+ * @param size 文本的字节数。
+ * @param stats 若不为空，写入解析的字节数、行数和耗时。
+ * @param threads 线程数，0表示使用全部硬件线程。
+ * @return Dataset
+ */
+Dataset parse_csv(const char *data, size_t size, Csv_stats *stats, size_t threads){
+    const auto time_start = std::chrono::steady_clock::now();
+
+    Csv_reader reader(data, size, threads);
+    Dataset dataset = reader.done() ? Dataset(std::vector<Column>(reader.columns()), 0) : reader.next(size);
+
+    if (stats){
+        stats->bytes = size;
+        stats->rows = dataset.row_count();
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - time_start).count();
+    }
+    return dataset;
+}
+
+/**
+ * @brief 解析时实际使用的SIMD指令集名称，AVX2在运行时检测。
+ *
+ */
+const char *csv_simd_name(){
+#if defined(CSV_SIMD_AVX2)
+    if (avx2_enabled()){
+        return "AVX2";
+    }
+#endif
+#if defined(CSV_SIMD_SSE2)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
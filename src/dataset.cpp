@@ -0,0 +1,330 @@
+#include "include/dataset.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+/**
+ * @brief 将int32列提升为float32列。
+ *
+ */
+void promote_to_float(Column &column){
+    column.floats.resize(column.ints.size());
+    for (size_t i = 0; i < column.ints.size(); i ++){
+        column.floats[i] = column.ints[i] == Dataset::null_int ? NAN : float(column.ints[i]);
+    }
+    column.ints.clear();
+    column.ints.shrink_to_fit();
+    column.type = Column_type::float32;
+}
+
+/**
+ * @brief Construct a new Dataset::Dataset object
+ *
+ * @param _columns 各列的数据，长度均为_rows。
+ * @param _rows 行数。
+ */
+Dataset::Dataset(std::vector<Column> &&_columns, size_t _rows):
+    rows(_rows), columns(std::move(_columns)){
+}
+
+/**
+ * @brief 根据列名查找列序号。
+ *
+ * @param name 列名。
+ * @return int 列序号。不存在时返回-1。
+ */
+int Dataset::index_of(const std::string &name) const{
+    for (size_t col = 0; col < columns.size(); col ++){
+        if (columns[col].name == name){
+            return col;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief 获取单元格的数值。空值记为0，dictionary列返回编码。
+ *
+ */
+float Dataset::value(size_t row, size_t col) const{
+    const Column &column = columns[col];
+    if (column.type == Column_type::float32){
+        float value = column.floats[row];
+        return std::isnan(value) ? 0 : value;
+    }
+    int32_t value = column.ints[row];
+    return value == null_int ? 0 : float(value);
+}
+
+/**
+ * @brief 获取单元格的整数值。空值记为0。
+ *
+ */
+int32_t Dataset::int_value(size_t row, size_t col) const{
+    const Column &column = columns[col];
+    if (column.type == Column_type::float32){
+        float value = column.floats[row];
+        return std::isnan(value) ? 0 : int32_t(value);
+    }
+    int32_t value = column.ints[row];
+    return value == null_int ? 0 : value;
+}
+
+/**
+ * @brief 获取单元格的显示文本。空值为空字符串。
+ *
+ */
+std::string Dataset::text(size_t row, size_t col) const{
+    const Column &column = columns[col];
+    switch (column.type){
+    case Column_type::float32: {
+        float value = column.floats[row];
+        if (std::isnan(value)){
+            return {};
+        }
+        char buffer[32];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        return std::string(buffer, result.ptr);
+    }
+    case Column_type::int32: {
+        int32_t value = column.ints[row];
+        return value == null_int ? std::string() : std::to_string(value);
+    }
+    case Column_type::dictionary: {
+        int32_t code = column.ints[row];
+        return code == null_int ? std::string() : column.dict[code];
+    }
+    }
+    return {};
+}
+
+/**
+ * @brief 获取一列的全部数值。空值记为0。
+ *
+ * @param col 列序号。
+ * @return std::vector<float>
+ */
+std::vector<float> Dataset::column_values(size_t col) const{
+    std::vector<float> values(rows);
+    for (size_t row = 0; row < rows; row ++){
+        values[row] = value(row, col);
+    }
+    return values;
+}
+
+/**
+ * @brief 获取若干列组成的数值矩阵，不逐行分配内存，也不经过文本转换。
+ * 无空值的float32列整列复制，其余列逐个元素转换。
+ *
+ * @param cols 列序号，依次为矩阵的各列。
+ * @return Dataset_View
+ */
+Dataset_View Dataset::select(const std::vector<size_t> &cols) const{
+    Dataset_View view;
+    view.cnt_rows = rows;
+    view.cnt_cols = cols.size();
+
+    if (cols.size() == 1){
+        const Column &column = columns[cols[0]];
+        if (column.type == Column_type::float32 && column.null_count == 0){
+            view.borrowed = column.floats.data();
+            return view;
+        }
+    }
+
+    view.storage.resize(rows, cols.size());
+    for (size_t j = 0; j < cols.size(); j ++){
+        const Column &column = columns[cols[j]];
+        float *out = view.storage.col(j).data();
+        if (column.type == Column_type::float32){
+            if (rows > 0){
+                std::memcpy(out, column.floats.data(), rows * sizeof(float));
+            }
+            if (column.null_count > 0){
+                std::replace_if(out, out + rows, [](float value){ return std::isnan(value); }, 0.0f);
+            }
+        }
+        else {
+            for (size_t row = 0; row < rows; row ++){
+                const int32_t value = column.ints[row];
+                out[row] = value == null_int ? 0 : float(value);
+            }
+        }
+    }
+    return view;
+}
+
+/**
+ * @brief 取出矩阵。持有副本时直接移出，否则复制所指向的列。
+ *
+ * @return Eigen::MatrixXf
+ */
+Eigen::MatrixXf Dataset_View::release(){
+    Eigen::MatrixXf released = borrowed ? Eigen::MatrixXf(matrix()) : std::move(storage);
+    borrowed = nullptr;
+    storage.resize(0, 0);
+    cnt_rows = 0;
+    cnt_cols = 0;
+    return released;
+}
+
+/**
+ * @brief 获取一列的全部整数值。空值记为0。
+ *
+ * @param col 列序号。
+ * @return std::vector<int>
+ */
+std::vector<int> Dataset::int_column(size_t col) const{
+    std::vector<int> values(rows);
+    for (size_t row = 0; row < rows; row ++){
+        values[row] = int_value(row, col);
+    }
+    return values;
+}
+
+/**
+ * @brief 添加或替换一个int32列，例如聚类分组。
+ *
+ * @param name 列名。已存在时替换该列。
+ * @param values 每一行的值，数量需与行数一致。
+ */
+void Dataset::set_int_column(const std::string &name, const std::vector<int> &values){
+    int col = index_of(name);
+    if (col < 0){
+        columns.emplace_back();
+        col = columns.size() - 1;
+    }
+    Column &column = columns[col];
+    column.name = name;
+    column.type = Column_type::int32;
+    column.floats.clear();
+    column.dict.clear();
+    column.ints.assign(values.begin(), values.end());
+    column.null_count = 0;
+    column.profile = Column_Profile();
+}
+
+/**
+ * @brief 判断segment能否追加到本表：本表为空，或两者的列数和各列列名相同。
+ *
+ */
+bool Dataset::can_append(const Dataset &segment) const{
+    if (columns.empty()){
+        return true;
+    }
+    if (segment.columns.size() != columns.size()){
+        return false;
+    }
+    for (size_t col = 0; col < columns.size(); col ++){
+        if (segment.columns[col].name != columns[col].name){
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 在末尾追加一批行，例如后台加载时逐批解析出的数据。
+ * 任一方为float32的int32列提升为float32，dictionary列的编码按本表的取值表重新编号。
+ *
+ * @param segment 列名和列数与本表相同的数据。本表为空时直接取用。
+ * @return true 已追加。
+ * @return false 列不一致（例如加载期间本表被添加了列），本表不变。
+ */
+bool Dataset::append(Dataset &&segment){
+    if (!can_append(segment)){
+        return false;
+    }
+    if (columns.empty()){
+        *this = std::move(segment);
+        return true;
+    }
+
+    for (size_t col = 0; col < columns.size(); col ++){
+        Column &column = columns[col];
+        Column &part = segment.columns[col];
+        if (column.type == Column_type::int32 && part.type == Column_type::float32){
+            promote_to_float(column);
+        }
+        else if (column.type == Column_type::float32 && part.type == Column_type::int32){
+            promote_to_float(part);
+        }
+
+        column.null_count += part.null_count;
+        column.profile = Column_Profile();
+        switch (column.type){
+        case Column_type::float32:
+            column.floats.insert(column.floats.end(), part.floats.begin(), part.floats.end());
+            break;
+        case Column_type::int32:
+            column.ints.insert(column.ints.end(), part.ints.begin(), part.ints.end());
+            break;
+        case Column_type::dictionary: {
+            std::unordered_map<std::string, int32_t> codes;
+            for (size_t code = 0; code < column.dict.size(); code ++){
+                codes.emplace(column.dict[code], int32_t(code));
+            }
+            std::vector<int32_t> remap(part.dict.size());
+            for (size_t code = 0; code < part.dict.size(); code ++){
+                auto inserted = codes.emplace(part.dict[code], int32_t(column.dict.size()));
+                if (inserted.second){
+                    column.dict.push_back(part.dict[code]);
+                }
+                remap[code] = inserted.first->second;
+            }
+            column.ints.reserve(column.ints.size() + part.ints.size());
+            for (int32_t code : part.ints){
+                column.ints.push_back(code == null_int ? code : remap[code]);
+            }
+            break;
+        }
+        }
+    }
+    rows += segment.rows;
+    segment.clear();
+    return true;
+}
+
+/**
+ * @brief 并行统计尚未统计的数值列，见profile_columns。
+ *
+ * @param threads 线程数，0表示全部硬件线程。
+ */
+void Dataset::update_profiles(size_t threads){
+    profile_columns(columns, rows, threads);
+}
+
+/**
+ * @brief 统计cols中的各列，不修改数据表，可以在后台线程中调用。调用期间数据表不能被修改。
+ *
+ * @param cols 要统计的列，通常为unprofiled_columns()。
+ * @param threads 线程数，0表示全部硬件线程。
+ * @param keep_going 返回false时取消，见::compute_profiles。
+ * @return std::vector<Column_Profile> 与cols对应的统计结果，用set_profiles写回。
+ */
+std::vector<Column_Profile> Dataset::compute_profiles(const std::vector<size_t> &cols, size_t threads,
+                                                      const std::function<bool()> &keep_going) const{
+    return ::compute_profiles(columns, cols, rows, threads, keep_going);
+}
+
+/**
+ * @brief 写回compute_profiles的结果。
+ *
+ */
+void Dataset::set_profiles(const std::vector<size_t> &cols, std::vector<Column_Profile> &&profiles){
+    for (size_t i = 0; i < cols.size() && i < profiles.size(); i ++){
+        columns[cols[i]].profile = std::move(profiles[i]);
+    }
+}
+
+/**
+ * @brief 清空数据表。
+ *
+ */
+void Dataset::clear(){
+    rows = 0;
+    columns.clear();
+}
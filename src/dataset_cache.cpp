@@ -0,0 +1,321 @@
+#include "include/dataset_cache.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+/*
+ * .dacache文件布局（本机字节序）：
+ *   Cache_header
+ *   Cache_column × cols
+ *   字符串区：列名，以及dictionary列的取值表（每项为uint32长度加内容）
+ *   各列的数据块，每块按cache_alignment对齐，内容为rows个float或int32
+ */
+
+namespace {
+
+const char cache_magic[8] = {'D', 'A', 'C', 'A', 'C', 'H', 'E', '\0'};
+const uint32_t cache_version = 1;
+const uint32_t cache_byte_order = 0x01020304;
+// 列数据块的对齐字节数
+const uint64_t cache_alignment = 64;
+// 写列数据时每次写入的最大字节数，每次写入前检查是否取消
+const uint64_t cache_write_bytes = 16 << 20;
+
+struct Cache_header{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    // 源文件的大小、修改时间（毫秒）和绝对路径的哈希，任一不符则缓存失效
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint64_t path_hash;
+    uint64_t rows;
+    uint64_t cols;
+    uint64_t strings_offset;
+    uint64_t strings_bytes;
+};
+
+struct Cache_column{
+    uint32_t type;
+    uint32_t name_bytes;
+    // 在字符串区中的偏移
+    uint64_t name_offset;
+    uint64_t null_count;
+    // 取值表在字符串区中的偏移和项数
+    uint64_t dict_offset;
+    uint64_t dict_count;
+    // 数据块在文件中的偏移和字节数
+    uint64_t data_offset;
+    uint64_t data_bytes;
+};
+
+static_assert(std::is_trivially_copyable<Cache_header>::value, "Cache_header must be trivially copyable");
+static_assert(std::is_trivially_copyable<Cache_column>::value, "Cache_column must be trivially copyable");
+static_assert(sizeof(float) == 4 && sizeof(int32_t) == 4, "column cells must be 4 bytes");
+
+uint64_t align_up(uint64_t value){
+    return (value + cache_alignment - 1) / cache_alignment * cache_alignment;
+}
+
+/**
+ * @brief 绝对路径的FNV-1a哈希。不使用qHash，因为它的种子每次运行都不同。
+ *
+ */
+uint64_t hash_path(const QString &path){
+    const QByteArray bytes = path.toUtf8();
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : bytes){
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/**
+ * @brief 检查[offset, offset + bytes)是否在文件范围内。
+ *
+ */
+bool in_bounds(uint64_t offset, uint64_t bytes, uint64_t file_size){
+    return offset <= file_size && bytes <= file_size - offset;
+}
+
+} // namespace
+
+/**
+ * @brief 源文件对应的缓存文件路径，即在源文件名后加上.dacache。
+ *
+ * @param source_path csv文件路径。
+ * @return QString
+ */
+QString dataset_cache_path(const QString &source_path){
+    return source_path + ".dacache";
+}
+
+/**
+ * @brief 取得源文件当前的标识。
+ *
+ * @param source_path csv文件路径。
+ * @param key 成功时写入的标识。
+ * @return 源文件存在且为普通文件时返回true。
+ */
+bool get_source_key(const QString &source_path, Cache_source_key &key){
+    const QFileInfo info(source_path);
+    if (!info.exists() || !info.isFile()){
+        return false;
+    }
+    key.size = info.size();
+    key.mtime = info.lastModified().toMSecsSinceEpoch();
+    key.path_hash = hash_path(info.absoluteFilePath());
+    return true;
+}
+
+/**
+ * @brief 内存映射缓存文件并读出数据表，不需要解析文本。各列从映射中整块复制到Dataset自己的数组，
+ * 返回后映射即关闭，缓存文件可以被重新写入或删除。
+ *
+ * 缓存可能损坏或来自旧版本，所有偏移、长度、项数和编码都先检查再使用。
+ *
+ * @param source_path csv文件路径。
+ * @param dataset 读取成功时写入的数据表。
+ * @return 缓存存在、与源文件的大小、修改时间和路径一致且格式正确时返回true。
+ */
+bool load_dataset_cache(const QString &source_path, Dataset &dataset){
+    Cache_source_key key;
+    if (!get_source_key(source_path, key)){
+        return false;
+    }
+
+    QFile file(dataset_cache_path(source_path));
+    if (!file.open(QIODevice::ReadOnly)){
+        return false;
+    }
+    const uint64_t file_size = file.size();
+    if (file_size < sizeof(Cache_header)){
+        return false;
+    }
+    const uchar *data = file.map(0, file_size);
+    if (!data){
+        return false;
+    }
+
+    Cache_header header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0
+        || header.version != cache_version
+        || header.byte_order != cache_byte_order
+        || header.source_size != key.size
+        || header.source_mtime != key.mtime
+        || header.path_hash != key.path_hash){
+        return false;
+    }
+//    每列的数据都在文件中，rows不超过file_size / 4，rows * sizeof(float)不会溢出
+    if (header.cols > (file_size - sizeof(header)) / sizeof(Cache_column)
+        || header.rows > file_size / sizeof(float)
+        || !in_bounds(header.strings_offset, header.strings_bytes, file_size)){
+        return false;
+    }
+    const uchar *strings = data + header.strings_offset;
+    const size_t rows = header.rows;
+
+    std::vector<Column> columns(header.cols);
+    for (size_t col = 0; col < header.cols; col ++){
+        Cache_column desc;
+        std::memcpy(&desc, data + sizeof(header) + col * sizeof(Cache_column), sizeof(desc));
+        if (desc.type > static_cast<uint32_t>(Column_type::dictionary)
+            || !in_bounds(desc.name_offset, desc.name_bytes, header.strings_bytes)
+            || desc.data_bytes != rows * sizeof(float)
+            || !in_bounds(desc.data_offset, desc.data_bytes, file_size)){
+            return false;
+        }
+
+        Column &column = columns[col];
+        column.type = static_cast<Column_type>(desc.type);
+        column.name.assign(reinterpret_cast<const char *>(strings + desc.name_offset), desc.name_bytes);
+        column.null_count = desc.null_count;
+
+        if (column.type == Column_type::dictionary){
+//            每项至少有4字节的长度，先检查项数再预留空间
+            if (desc.dict_count > header.strings_bytes / sizeof(uint32_t)){
+                return false;
+            }
+            uint64_t offset = desc.dict_offset;
+            column.dict.reserve(desc.dict_count);
+            for (uint64_t i = 0; i < desc.dict_count; i ++){
+                uint32_t length;
+                if (!in_bounds(offset, sizeof(length), header.strings_bytes)){
+                    return false;
+                }
+                std::memcpy(&length, strings + offset, sizeof(length));
+                offset += sizeof(length);
+                if (!in_bounds(offset, length, header.strings_bytes)){
+                    return false;
+                }
+                column.dict.emplace_back(reinterpret_cast<const char *>(strings + offset), length);
+                offset += length;
+            }
+        }
+
+        const uchar *block = data + desc.data_offset;
+        if (column.type == Column_type::float32){
+            column.floats.resize(rows);
+            std::memcpy(column.floats.data(), block, desc.data_bytes);
+        }
+        else {
+            column.ints.resize(rows);
+            std::memcpy(column.ints.data(), block, desc.data_bytes);
+        }
+
+//        Dataset按编码直接访问取值表，编码必须为空值或小于取值表的项数
+        if (column.type == Column_type::dictionary){
+            const int64_t cnt_dict = column.dict.size();
+            for (int32_t code : column.ints){
+                if (code != Dataset::null_int && (code < 0 || code >= cnt_dict)){
+                    return false;
+                }
+            }
+        }
+    }
+
+    dataset = Dataset(std::move(columns), rows);
+    return true;
+}
+
+/**
+ * @brief 将数据表写为源文件旁的缓存文件。先写临时文件，成功后再替换，避免留下半个缓存。
+ * 可以在后台线程中调用，期间数据表不能被修改。
+ *
+ * @param source_path csv文件路径。
+ * @param key 读取源文件之前取得的标识。
+ * @param dataset 从该csv文件解析出的数据表。
+ * @param keep_going 不为空时在每次写入列数据之前调用，返回false则放弃写入。
+ * @return 是否写入成功，取消时返回false。
+ */
+bool save_dataset_cache(const QString &source_path, const Cache_source_key &key, const Dataset &dataset,
+                        const std::function<bool()> &keep_going){
+    const size_t rows = dataset.row_count();
+    const size_t cols = dataset.column_count();
+
+//    列名和取值表写入字符串区
+    QByteArray strings;
+    std::vector<Cache_column> descs(cols);
+    for (size_t col = 0; col < cols; col ++){
+        const Column &column = dataset.column(col);
+        Cache_column &desc = descs[col];
+        std::memset(&desc, 0, sizeof(desc));
+        desc.type = static_cast<uint32_t>(column.type);
+        desc.null_count = column.null_count;
+        desc.name_offset = strings.size();
+        desc.name_bytes = column.name.size();
+        strings.append(column.name.data(), column.name.size());
+        desc.dict_offset = strings.size();
+        desc.dict_count = column.dict.size();
+        for (const std::string &entry : column.dict){
+            const uint32_t length = entry.size();
+            strings.append(reinterpret_cast<const char *>(&length), sizeof(length));
+            strings.append(entry.data(), entry.size());
+        }
+    }
+
+    Cache_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+    header.version = cache_version;
+    header.byte_order = cache_byte_order;
+    header.source_size = key.size;
+    header.source_mtime = key.mtime;
+    header.path_hash = key.path_hash;
+    header.rows = rows;
+    header.cols = cols;
+    header.strings_offset = sizeof(header) + cols * sizeof(Cache_column);
+    header.strings_bytes = strings.size();
+
+    uint64_t offset = align_up(header.strings_offset + header.strings_bytes);
+    for (Cache_column &desc : descs){
+        desc.data_offset = offset;
+        desc.data_bytes = rows * sizeof(float);
+        offset = align_up(offset + desc.data_bytes);
+    }
+
+    QSaveFile file(dataset_cache_path(source_path));
+    if (!file.open(QIODevice::WriteOnly)){
+        return false;
+    }
+    uint64_t position = 0;
+    auto write = [&](const void *bytes, uint64_t size){
+        if (size > 0 && file.write(static_cast<const char *>(bytes), size) != static_cast<qint64>(size)){
+            return false;
+        }
+        position += size;
+        return true;
+    };
+    auto pad_to = [&](uint64_t target){
+        const QByteArray zeros(target - position, '\0');
+        return write(zeros.constData(), zeros.size());
+    };
+
+    bool ok = write(&header, sizeof(header))
+              && write(descs.data(), cols * sizeof(Cache_column))
+              && write(strings.constData(), strings.size());
+    for (size_t col = 0; ok && col < cols; col ++){
+        const Column &column = dataset.column(col);
+        const char *block = column.type == Column_type::float32
+                                ? reinterpret_cast<const char *>(column.floats.data())
+                                : reinterpret_cast<const char *>(column.ints.data());
+        ok = pad_to(descs[col].data_offset);
+        for (uint64_t done = 0; ok && done < descs[col].data_bytes; done += cache_write_bytes){
+            ok = (!keep_going || keep_going())
+                 && write(block + done, std::min(cache_write_bytes, descs[col].data_bytes - done));
+        }
+    }
+    if (!ok){
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
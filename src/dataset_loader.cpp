@@ -0,0 +1,111 @@
+#include "include/dataset_loader.h"
+#include "include/csv_parser.h"
+#include "include/dataset_cache.h"
+#include "include/needed_algo/parallel.hpp"
+
+#include <QElapsedTimer>
+#include <QFile>
+
+#include <algorithm>
+
+namespace {
+
+// 第一批的字节数，较小以便尽快显示表格
+const size_t first_batch_bytes = 256 << 10;
+
+// 每个线程每批最多解析的字节数，批越大并行解析越充分
+const size_t batch_bytes_per_thread = 4 << 20;
+
+} // namespace
+
+/**
+ * @brief Construct a new Dataset_Loader::Dataset_Loader object
+ *
+ * @param _path csv文件路径，可以是资源文件。
+ * @param parent
+ */
+Dataset_Loader::Dataset_Loader(const QString &_path, QObject *parent):
+    QThread(parent), path(_path){
+}
+
+/**
+ * @brief 取走已解析的各批数据，按文件中的顺序排列。
+ *
+ * @return std::vector<Dataset>
+ */
+std::vector<Dataset> Dataset_Loader::take_segments(){
+    QMutexLocker locker(&mutex);
+    std::vector<Dataset> taken;
+    taken.swap(segments);
+    return taken;
+}
+
+void Dataset_Loader::push_segment(Dataset &&segment){
+    {
+        QMutexLocker locker(&mutex);
+        segments.push_back(std::move(segment));
+    }
+    emit segments_ready();
+}
+
+/**
+ * @brief 后台线程的入口。缓存有效时直接读取缓存，否则内存映射文件并逐批解析，
+ * 每批的大小从first_batch_bytes起倍增。
+ *
+ */
+void Dataset_Loader::run(){
+    QElapsedTimer timer;
+    timer.start();
+
+//    资源文件不可写，不使用缓存
+    const bool use_cache = !path.startsWith(":");
+    Dataset cached;
+    if (use_cache && load_dataset_cache(path, cached)){
+        const qint64 rows = cached.row_count();
+        const qint64 size = QFile(path).size();
+        cache_hit = true;
+        push_segment(std::move(cached));
+        emit progress(size, size, rows, timer.elapsed() / 1000.0);
+        success = true;
+        return;
+    }
+
+//    在映射文件之前取得标识，读取期间文件被修改时写出的缓存不会被当作有效
+    has_key = use_cache && get_source_key(path, key);
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)){
+        return;
+    }
+//    优先内存映射文件，映射失败（如压缩的资源文件）时读入内存
+    QByteArray content;
+    const char *data = nullptr;
+    size_t size = file.size();
+    if (size > 0){
+        data = reinterpret_cast<const char *>(file.map(0, size));
+    }
+    if (!data){
+        content = file.readAll();
+        data = content.constData();
+        size = content.size();
+    }
+
+    Csv_reader reader(data, size);
+    if (reader.done()){
+        push_segment(Dataset(std::vector<Column>(reader.columns()), 0));
+    }
+
+    const size_t max_batch_bytes = hardwareThreads() * batch_bytes_per_thread;
+    size_t batch_bytes = first_batch_bytes;
+    qint64 rows = 0;
+    while (!reader.done()){
+        if (isInterruptionRequested()){
+            return;
+        }
+        Dataset segment = reader.next(batch_bytes);
+        rows += segment.row_count();
+        push_segment(std::move(segment));
+        emit progress(reader.bytes_done(), reader.bytes_total(), rows, timer.elapsed() / 1000.0);
+        batch_bytes = std::min(batch_bytes * 2, max_batch_bytes);
+    }
+    success = true;
+}
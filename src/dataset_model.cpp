@@ -0,0 +1,165 @@
+#include "dataset_model.h"
+
+#include <QBrush>
+
+/**
+ * @brief Construct a new Dataset_Model::Dataset_Model object
+ *
+ * @param _dataset 数据表。由调用者持有，生命周期需长于模型。
+ * @param parent
+ */
+Dataset_Model::Dataset_Model(Dataset *_dataset, QObject *parent):
+    QAbstractTableModel(parent), dataset(_dataset){
+}
+
+int Dataset_Model::rowCount(const QModelIndex &parent) const{
+    return parent.isValid() ? 0 : dataset->row_count();
+}
+
+int Dataset_Model::columnCount(const QModelIndex &parent) const{
+    return parent.isValid() ? 0 : dataset->column_count();
+}
+
+/**
+ * @brief 按需生成单元格的文本和背景色。只有可见的行会被视图请求。
+ *
+ * @param index 单元格位置。
+ * @param role Qt::DisplayRole返回文本，Qt::BackgroundRole返回分组的背景色。
+ * @return QVariant
+ */
+QVariant Dataset_Model::data(const QModelIndex &index, int role) const{
+    if (!index.isValid()){
+        return {};
+    }
+    const size_t row = index.row();
+    const size_t col = index.column();
+    if (row >= dataset->row_count() || col >= dataset->column_count()){
+        return {};
+    }
+
+    switch (role){
+    case Qt::DisplayRole:
+        return QString::fromStdString(dataset->text(row, col));
+    case Qt::BackgroundRole:
+        if (row < row_labels.size()){
+            const int label = row_labels[row];
+            if (label >= 0 && static_cast<size_t>(label) < group_colors.size()){
+                return QBrush(group_colors[label]);
+            }
+        }
+        return {};
+    default:
+        return {};
+    }
+}
+
+/**
+ * @brief 水平表头为列名，竖直表头为从1开始的行号。
+ *
+ */
+QVariant Dataset_Model::headerData(int section, Qt::Orientation orientation, int role) const{
+    if (role != Qt::DisplayRole){
+        return {};
+    }
+    if (orientation == Qt::Horizontal){
+        if (section < 0 || static_cast<size_t>(section) >= dataset->column_count()){
+            return {};
+        }
+        return QString::fromStdString(dataset->name(section));
+    }
+    return section + 1;
+}
+
+/**
+ * @brief 替换整个数据表，并清除着色。
+ *
+ * @param new_dataset 新的数据表。
+ */
+void Dataset_Model::set_dataset(Dataset &&new_dataset){
+    beginResetModel();
+    *dataset = std::move(new_dataset);
+    row_labels.clear();
+    group_colors.clear();
+    endResetModel();
+}
+
+/**
+ * @brief 在末尾追加一批行，视图只需布局新增的行。数据表为空时按新表处理。
+ * 若某列因这一批被提升为float32，已有行的文本可能改变（超过2^24的整数），需通知视图重绘该列。
+ * dictionary列追加时保留已有的编码，只为新取值分配编码，已有行不受影响。
+ *
+ * @param segment 列名和列数与当前数据表相同的数据。
+ * @return false 列与当前数据表不一致，未追加。
+ */
+bool Dataset_Model::append_rows(Dataset &&segment){
+    if (dataset->empty()){
+        set_dataset(std::move(segment));
+        return true;
+    }
+    if (!dataset->can_append(segment)){
+        return false;
+    }
+    if (segment.row_count() == 0){
+        return true;
+    }
+    std::vector<Column_type> types_old(dataset->column_count());
+    for (size_t col = 0; col < types_old.size(); col ++){
+        types_old[col] = dataset->column(col).type;
+    }
+
+    const int first = dataset->row_count();
+    beginInsertRows(QModelIndex(), first, first + segment.row_count() - 1);
+    dataset->append(std::move(segment));
+    endInsertRows();
+
+    for (size_t col = 0; col < types_old.size(); col ++){
+        if (dataset->column(col).type != types_old[col]){
+            emit dataChanged(index(0, col), index(first - 1, col), {Qt::DisplayRole});
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 添加或替换一个int32列，例如聚类分组，并通知视图。
+ *
+ * @param name 列名。
+ * @param values 每一行的值。
+ */
+void Dataset_Model::set_int_column(const std::string &name, const std::vector<int> &values){
+    const int col = dataset->index_of(name);
+    if (col < 0){
+        const int col_new = dataset->column_count();
+        beginInsertColumns(QModelIndex(), col_new, col_new);
+        dataset->set_int_column(name, values);
+        endInsertColumns();
+        return;
+    }
+    dataset->set_int_column(name, values);
+    if (dataset->row_count() > 0){
+        emit dataChanged(index(0, col), index(dataset->row_count() - 1, col), {Qt::DisplayRole});
+    }
+}
+
+/**
+ * @brief 按每一行的分组设置背景色。
+ *
+ * @param labels 每一行的分组，-1表示不着色。
+ * @param colors 每个分组的颜色。
+ */
+void Dataset_Model::set_row_colors(const std::vector<int> &labels, const std::vector<QColor> &colors){
+    row_labels = labels;
+    group_colors = colors;
+    if (dataset->row_count() > 0 && dataset->column_count() > 0){
+        emit dataChanged(index(0, 0), index(dataset->row_count() - 1, dataset->column_count() - 1),
+                         {Qt::BackgroundRole});
+    }
+}
+
+/**
+ * @brief 取消所有行的着色。
+ *
+ */
+void Dataset_Model::clear_row_colors(){
+    set_row_colors({}, {});
+}
@@ -0,0 +1,43 @@
+#ifndef DATASET_MODEL_H
+#define DATASET_MODEL_H
+
+#include "include/dataset.h"
+
+#include <QAbstractTableModel>
+#include <QColor>
+
+/**
+ * @brief 数据表的只读视图。单元格文本在data()被调用时才生成，不额外保存任何单元格对象。
+ *
+ */
+class Dataset_Model : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    explicit Dataset_Model(Dataset *dataset, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    void set_dataset(Dataset &&new_dataset);
+
+    bool append_rows(Dataset &&segment);
+
+    void set_int_column(const std::string &name, const std::vector<int> &values);
+
+    void set_row_colors(const std::vector<int> &labels, const std::vector<QColor> &colors);
+
+    void clear_row_colors();
+
+private:
+    Dataset *dataset;
+
+    // 每一行的分组，决定背景色；为空或-1时不着色
+    std::vector<int> row_labels;
+    // 每个分组的背景色
+    std::vector<QColor> group_colors;
+};
+
+#endif // DATASET_MODEL_H
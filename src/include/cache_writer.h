@@ -0,0 +1,32 @@
+#ifndef CACHE_WRITER_H
+#define CACHE_WRITER_H
+
+#include "dataset.h"
+#include "dataset_cache.h"
+
+#include <QString>
+#include <QThread>
+
+/**
+ * @brief 在后台线程中为加载完成的数据表写缓存文件。运行期间数据表不能被修改；
+ * 调用requestInterruption可在两次写入之间放弃写入，不会留下缓存文件。
+ *
+ */
+class Cache_Writer : public QThread
+{
+    Q_OBJECT
+public:
+    Cache_Writer(const Dataset &dataset, const QString &source_path, const Cache_source_key &key,
+                 QObject *parent = nullptr);
+
+protected:
+    void run() override;
+
+private:
+    const Dataset &dataset;
+    const QString source_path;
+    // 读取源文件之前取得的标识
+    const Cache_source_key key;
+};
+
+#endif // CACHE_WRITER_H
@@ -0,0 +1,80 @@
+#ifndef CLUSTER_TASK_H
+#define CLUSTER_TASK_H
+
+#include "needed_algo/kmeans.hpp"
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+
+enum class Cluster_method{
+    kmeans,
+    dbscan,
+    minibatch
+};
+
+/**
+ * @brief 在后台线程中运行聚类。运行中发出progress报告进度；K-means每隔一段时间
+ * 发出preview_ready，可用take_preview取走当前的分组预览。调用requestInterruption可取消。
+ * 结束后用take_labels取走最终的分组。
+ *
+ */
+class Cluster_Task : public QThread
+{
+    Q_OBJECT
+public:
+    Cluster_Task(Cluster_method method, Eigen::MatrixXf &&samples, QObject *parent = nullptr);
+
+    // 启动前设置的参数，K-means和Mini-batch K-means使用kmeans_options
+    KMeansOptions kmeans_options;
+    float dbscan_epsilon = 15;
+    int dbscan_minPts = 3;
+
+    Cluster_method method() const { return cluster_method; }
+
+    // 是否正常完成，取消或出错时为false
+    bool succeeded() const { return success; }
+    // 出错时的错误信息，取消时为空
+    QString error_message() const { return error; }
+
+    std::vector<int> take_labels() { return std::move(labels); }
+    std::vector<int> take_preview();
+
+    // K-means的结果
+    int iterations() const { return cnt_iterations; }
+    double inertia() const { return final_inertia; }
+    bool converged() const { return is_converged; }
+
+signals:
+    void progress(int done, int total, const QString &text);
+
+    void preview_ready();
+
+protected:
+    void run() override;
+
+private:
+    const Cluster_method cluster_method;
+    const Eigen::MatrixXf samples;
+
+    std::vector<int> labels;
+    bool success = false;
+    QString error;
+    int cnt_iterations = 0;
+    double final_inertia = 0;
+    bool is_converged = false;
+
+    // 进度和预览由算法的各线程报告，按时间间隔限流
+    QMutex mutex;
+    QElapsedTimer timer_progress;
+    QElapsedTimer timer_preview;
+    std::vector<int> preview;
+    // K-means各次运行已完成的轮数
+    std::vector<int> restart_iterations;
+
+    bool report(int done, int total, const QString &text);
+    bool report_kmeans(const KMeansProgress &state);
+};
+
+#endif // CLUSTER_TASK_H
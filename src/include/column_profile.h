@@ -0,0 +1,47 @@
+#ifndef COLUMN_PROFILE_H
+#define COLUMN_PROFILE_H
+
+#include "needed_algo/histogram.hpp"
+#include "needed_algo/kll.hpp"
+#include "needed_algo/moments.hpp"
+
+#include <functional>
+#include <vector>
+
+// 细分直方图的组数。2520是1~10的最小公倍数，约数较密；显示的组数取其约数，合并后各组等宽
+const int profile_bins = 2520;
+
+struct Column;
+
+/**
+ * @brief 一列的概要统计，加载完成后对每个数值列并行计算一次，方差、直方图等窗口直接读取。
+ * 均值、方差、最值和直方图都不含空值；全为空值的列moments.count为0，最值无意义，直方图为全0。
+ *
+ */
+struct Column_Profile{
+    // 是否已统计。dictionary列，以及被修改后尚未重新统计的列为false
+    bool valid = false;
+
+    Moments moments;
+    size_t null_count = 0;
+    // HyperLogLog估计的不同取值数
+    double distinct = 0;
+    // 将[moments.min, moments.max]等分为profile_bins组的频次，最大值计入最后一组。
+    // 各种组数的直方图都由其合并得到，不再读取数据
+    std::vector<long long> fine_histogram;
+    // 分位数sketch，中位数、四分位数等由此估计
+    KllSketch quantiles;
+
+    int bin_count(BinRule rule, int fixed_bins = 0) const;
+    Histogram binned(BinRule rule, int fixed_bins = 0) const;
+};
+
+std::vector<Column_Profile> compute_profiles(const std::vector<Column> &columns, const std::vector<size_t> &targets,
+                                             size_t rows, size_t threads = 0,
+                                             const std::function<bool()> &keep_going = {});
+
+std::vector<size_t> unprofiled_columns(const std::vector<Column> &columns);
+
+void profile_columns(std::vector<Column> &columns, size_t rows, size_t threads = 0);
+
+#endif // COLUMN_PROFILE_H
@@ -0,0 +1,48 @@
+#ifndef CSV_PARSER_H
+#define CSV_PARSER_H
+
+#include "dataset.h"
+
+/**
+ * @brief csv解析的统计信息。
+ *
+ */
+struct Csv_stats{
+    size_t bytes = 0;
+    size_t rows = 0;
+    double seconds = 0;
+
+    double rows_per_second() const { return seconds > 0 ? rows / seconds : 0; }
+    double mb_per_second() const { return seconds > 0 ? bytes / seconds / (1024.0 * 1024.0) : 0; }
+};
+
+/**
+ * @brief 分批解析内存中的csv文本，用于后台加载时逐步显示数据。
+ *
+ */
+class Csv_reader{
+public:
+    Csv_reader(const char *data, size_t size, size_t threads = 0);
+
+    // 表头和推断出的列类型，不含数据
+    const std::vector<Column> &columns() const { return schema; }
+
+    bool done() const { return position >= end; }
+    size_t bytes_total() const { return end - begin; }
+    size_t bytes_done() const { return position - begin; }
+
+    Dataset next(size_t max_bytes);
+
+private:
+    const char *begin;
+    const char *position;
+    const char *end;
+    size_t threads;
+    std::vector<Column> schema;
+};
+
+Dataset parse_csv(const char *data, size_t size, Csv_stats *stats = nullptr, size_t threads = 0);
+
+const char *csv_simd_name();
+
+#endif // CSV_PARSER_H
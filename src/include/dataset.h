@@ -0,0 +1,127 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+#include "column_profile.h"
+
+#include <Eigen/Dense>
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 列的存储类型。
+ *
+ */
+enum class Column_type{
+    float32,
+    int32,
+    dictionary
+};
+
+/**
+ * @brief 数据表中的一列。按类型只使用其中一个连续缓冲区。
+ *
+ */
+struct Column{
+    std::string name;
+    Column_type type = Column_type::float32;
+
+    // float32列的数值，空值为NaN
+    std::vector<float> floats;
+    // int32列的数值（空值为Dataset::null_int），或dictionary列的编码
+    std::vector<int32_t> ints;
+    // dictionary列的取值表
+    std::vector<std::string> dict;
+
+    // 空值数量
+    size_t null_count = 0;
+
+    // 概要统计，列被修改后失效
+    Column_Profile profile;
+};
+
+void promote_to_float(Column &column);
+
+/**
+ * @brief 若干列的数值矩阵，样本为行、所选列为列，列主序。空值记为0，dictionary列为编码。
+ * 只选中一个无空值的float32列时直接指向该列的缓冲区，否则持有一次分配的副本。
+ * 直接指向缓冲区时，数据表被修改后视图失效。
+ *
+ */
+class Dataset_View
+{
+public:
+    Eigen::Map<const Eigen::MatrixXf> matrix() const { return {data(), cnt_rows, cnt_cols}; }
+
+    Eigen::Index rows() const { return cnt_rows; }
+    Eigen::Index cols() const { return cnt_cols; }
+    bool empty() const { return cnt_rows == 0 || cnt_cols == 0; }
+    bool is_borrowed() const { return borrowed != nullptr; }
+
+    Eigen::MatrixXf release();
+
+private:
+    friend class Dataset;
+
+    const float *borrowed = nullptr;
+    Eigen::MatrixXf storage;
+    Eigen::Index cnt_rows = 0;
+    Eigen::Index cnt_cols = 0;
+
+    const float *data() const { return borrowed ? borrowed : storage.data(); }
+};
+
+/**
+ * @brief 列式存储的数据表，持有全部数据。表格视图和各分析算法都从这里读取。
+ *
+ */
+class Dataset
+{
+public:
+    // int32列中的空值
+    static constexpr int32_t null_int = std::numeric_limits<int32_t>::min();
+
+    Dataset() = default;
+    Dataset(std::vector<Column> &&columns, size_t rows);
+
+    size_t row_count() const { return rows; }
+    size_t column_count() const { return columns.size(); }
+    bool empty() const { return columns.empty(); }
+
+    const Column &column(size_t col) const { return columns[col]; }
+    const std::string &name(size_t col) const { return columns[col].name; }
+    int index_of(const std::string &name) const;
+    bool is_numeric(size_t col) const { return columns[col].type != Column_type::dictionary; }
+    const Column_Profile &profile(size_t col) const { return columns[col].profile; }
+
+    float value(size_t row, size_t col) const;
+    int32_t int_value(size_t row, size_t col) const;
+    std::string text(size_t row, size_t col) const;
+
+    std::vector<float> column_values(size_t col) const;
+    Dataset_View select(const std::vector<size_t> &cols) const;
+    std::vector<int> int_column(size_t col) const;
+
+    void set_int_column(const std::string &name, const std::vector<int> &values);
+
+    bool can_append(const Dataset &segment) const;
+    bool append(Dataset &&segment);
+
+    void update_profiles(size_t threads = 0);
+
+    // 后台统计：先在界面线程取得要统计的列，在后台线程计算（只读），结束后在界面线程写回
+    std::vector<size_t> unprofiled_columns() const { return ::unprofiled_columns(columns); }
+    std::vector<Column_Profile> compute_profiles(const std::vector<size_t> &cols, size_t threads = 0,
+                                                 const std::function<bool()> &keep_going = {}) const;
+    void set_profiles(const std::vector<size_t> &cols, std::vector<Column_Profile> &&profiles);
+
+    void clear();
+
+private:
+    size_t rows = 0;
+    std::vector<Column> columns;
+};
+
+#endif // DATASET_H
@@ -0,0 +1,32 @@
+#ifndef DATASET_CACHE_H
+#define DATASET_CACHE_H
+
+#include "dataset.h"
+
+#include <QString>
+
+#include <functional>
+
+/**
+ * @brief 源文件的标识，任一项与缓存中记录的不符则缓存失效。
+ * 写缓存时使用读取源文件之前取得的标识，读取期间文件被修改时缓存在下次打开时即失效。
+ *
+ */
+struct Cache_source_key{
+    uint64_t size = 0;
+    // 修改时间，毫秒
+    int64_t mtime = 0;
+    // 绝对路径的哈希
+    uint64_t path_hash = 0;
+};
+
+QString dataset_cache_path(const QString &source_path);
+
+bool get_source_key(const QString &source_path, Cache_source_key &key);
+
+bool load_dataset_cache(const QString &source_path, Dataset &dataset);
+
+bool save_dataset_cache(const QString &source_path, const Cache_source_key &key, const Dataset &dataset,
+                        const std::function<bool()> &keep_going = {});
+
+#endif // DATASET_CACHE_H
@@ -0,0 +1,56 @@
+#ifndef DATASET_LOADER_H
+#define DATASET_LOADER_H
+
+#include "dataset.h"
+#include "dataset_cache.h"
+
+#include <QMutex>
+#include <QString>
+#include <QThread>
+
+/**
+ * @brief 在后台线程中加载csv文件。数据按批解析，每批解析完成后发出segments_ready，
+ * 由界面线程用take_segments取走并追加到表格中。调用requestInterruption可取消加载。
+ *
+ */
+class Dataset_Loader : public QThread
+{
+    Q_OBJECT
+public:
+    explicit Dataset_Loader(const QString &path, QObject *parent = nullptr);
+
+    std::vector<Dataset> take_segments();
+
+    // 是否完整读取了整个文件
+    bool succeeded() const { return success; }
+    // 数据是否来自缓存文件
+    bool from_cache() const { return cache_hit; }
+    // 是否应为读取的csv文件写缓存：完整解析了csv文件，且读取前取得了源文件标识
+    bool can_cache() const { return success && !cache_hit && has_key; }
+    // 读取csv文件之前的源文件标识，写缓存时使用
+    const Cache_source_key &source_key() const { return key; }
+
+signals:
+    void segments_ready();
+
+    void progress(qint64 bytes_done, qint64 bytes_total, qint64 rows, double seconds);
+
+protected:
+    void run() override;
+
+private:
+    QString path;
+
+    QMutex mutex;
+    // 已解析、尚未被取走的各批数据
+    std::vector<Dataset> segments;
+
+    bool success = false;
+    bool cache_hit = false;
+    bool has_key = false;
+    Cache_source_key key;
+
+    void push_segment(Dataset &&segment);
+};
+
+#endif // DATASET_LOADER_H
@@ -2,6 +2,33 @@
 #define COMMON_H
 #include <iostream>
 #include <vector>
+#include <stdexcept>
 #include "Eigen/Dense"
 
+// 将按行存放的样本转换为矩阵，每个样本为一行
+inline Eigen::MatrixXf toMatrix(const std::vector<std::vector<float>> &in)
+{
+    if (in.empty())
+    {
+        throw std::invalid_argument("in.empty()");
+    }
+
+    size_t row = in.size();
+    size_t col = in[0].size();
+
+    Eigen::MatrixXf mat(row, col);
+    for (size_t i = 0; i < row; i++)
+    {
+        if (in[i].size() != col)
+        {
+            throw std::invalid_argument("in[i].size() != col");
+        }
+        for (size_t j = 0; j < col; j++)
+        {
+            mat(i, j) = in[i][j];
+        }
+    }
+    return mat;
+}
+
 #endif // COMMON_H
\ No newline at end of file
@@ -2,72 +2,151 @@
 #define COVARIANCE_HPP
 
 #include "common.h"
+#include "parallel.hpp"
 #include "rowfeature.hpp"
 
-Eigen::MatrixXf getCovariance(const std::vector<std::vector<float>> &inMat)
+#include <chrono>
+#include <random>
+
+// 计算协方差时每次处理的行数。各线程把行块中心化后放在自己的缓冲区中，
+// 再对其做对称的秩k更新（SYRK），只计算下三角
+const long long covarianceBlockRows = 1024;
+
+// 样本为mat的各行，变量为各列。threads为0时使用全部硬件线程
+inline Eigen::MatrixXf getCovariance(const Eigen::Ref<const Eigen::MatrixXf> &mat, size_t threads = 0)
+{
+    if (mat.rows() == 0)
+    {
+        throw std::invalid_argument("mat.rows() == 0");
+    }
+
+    const long long n = mat.rows();
+    const int d = mat.cols();
+    const Eigen::RowVectorXf mean = (mat.cast<double>().colwise().sum() / double(n)).cast<float>();
+
+    // 各线程处理连续的若干行块，行块的乘积在float中计算，累加到各线程的double矩阵中
+    const size_t cntBlocks = (n + covarianceBlockRows - 1) / covarianceBlockRows;
+    threads = resolveThreads(threads, cntBlocks);
+    std::vector<Eigen::MatrixXd> partial(threads);
+    parallelFor(threads, threads, [&](size_t t)
+    {
+        auto range = blockRange(cntBlocks, threads, t);
+        Eigen::MatrixXd &sum = partial[t];
+        sum.setZero(d, d);
+        Eigen::MatrixXf centered;
+        Eigen::MatrixXf product(d, d);
+        for (size_t block = range.first; block < range.second; block++)
+        {
+            const long long begin = block * covarianceBlockRows;
+            const long long rows = std::min(covarianceBlockRows, n - begin);
+            centered = mat.middleRows(begin, rows).rowwise() - mean;
+            product.setZero();
+            product.selfadjointView<Eigen::Lower>().rankUpdate(centered.adjoint());
+            sum.triangularView<Eigen::Lower>() += product.cast<double>();
+        }
+    });
+
+    for (size_t t = 1; t < threads; t++)
+    {
+        partial[0].triangularView<Eigen::Lower>() += partial[t];
+    }
+    partial[0] /= double(std::max<long long>(1, n - 1));
+
+    Eigen::MatrixXd cov = partial[0].selfadjointView<Eigen::Lower>();
+    return cov.cast<float>();
+}
+
+// inMat的每一项为一个变量的全部取值，直接复制到矩阵的各列
+inline Eigen::MatrixXf getCovariance(const std::vector<std::vector<float>> &inMat)
 {
     if (inMat.empty())
     {
         throw std::invalid_argument("inMat.empty()");
     }
 
-    size_t row = inMat.size();
-    size_t col = inMat[0].size();
+    size_t row = inMat[0].size();
+    size_t col = inMat.size();
 
     Eigen::MatrixXf mat(row, col);
-    for (size_t i = 0; i < row; i++)
+    for (size_t j = 0; j < col; j++)
     {
-        if (inMat[i].size() != col)
-        {
-            throw std::invalid_argument("inMat[i].size() != col");
-        }
-        for (size_t j = 0; j < col; j++)
+        if (inMat[j].size() != row)
         {
-            mat(i, j) = inMat[i][j];
+            throw std::invalid_argument("inMat[j].size() != row");
         }
+        mat.col(j) = Eigen::Map<const Eigen::VectorXf>(inMat[j].data(), row);
     }
-    mat.transposeInPlace();
-
-    Eigen::MatrixXf centered = mat.rowwise() - mat.colwise().mean();
-    Eigen::MatrixXf cov = (centered.adjoint() * centered) / double(mat.rows() - 1);
-
-    return cov;
+    return getCovariance(mat);
 }
 
-Eigen::MatrixXf getPearsonCorr(const Eigen::MatrixXf &cov, const std::vector<float> &vars)
+// 用各变量的方差把协方差矩阵归一化为相关系数矩阵：corr = D * cov * D，D的对角元为1 / sqrt(var)。
+// 方差为0的变量与其他变量的相关系数记为0
+inline Eigen::MatrixXf getPearsonCorr(const Eigen::MatrixXf &cov, const Eigen::Ref<const Eigen::VectorXf> &vars)
 {
-    if (vars.empty())
+    if (vars.size() == 0)
     {
-        throw std::invalid_argument("vars.empty()");
+        throw std::invalid_argument("vars.size() == 0");
     }
 
-    size_t row = cov.rows();
-    size_t col = cov.cols();
-
-    if (row != col)
+    if (cov.rows() != cov.cols())
     {
         throw std::invalid_argument("row != col");
     }
 
-    if (row != vars.size())
+    if (cov.rows() != vars.size())
     {
         throw std::invalid_argument("row != vars.size()");
     }
 
-    Eigen::MatrixXf relativity(row, col);
-    for (size_t i = 0; i < row; i++)
+    const Eigen::VectorXf scale = (vars.array() > 0).select(vars.array().sqrt().inverse(), 0.0f);
+    Eigen::MatrixXf relativity = scale.asDiagonal() * cov * scale.asDiagonal();
+    relativity.diagonal().setOnes();
+    return relativity;
+}
+
+inline Eigen::MatrixXf getPearsonCorr(const Eigen::MatrixXf &cov, const std::vector<float> &vars)
+{
+    return getPearsonCorr(cov, Eigen::Map<const Eigen::VectorXf>(vars.data(), vars.size()));
+}
+
+// 方差取协方差矩阵的对角元
+inline Eigen::MatrixXf getPearsonCorr(const Eigen::MatrixXf &cov)
+{
+    return getPearsonCorr(cov, cov.diagonal());
+}
+
+// 与直接的矩阵乘积比较，输出最大误差和两种方法的耗时
+inline void testCovarianceSpeed(int n, int d)
+{
+    std::mt19937 rng(31);
+    std::normal_distribution<float> normal(0, 1);
+    Eigen::MatrixXf mat(n, d);
+    for (int j = 0; j < d; j++)
     {
-        relativity(i, i) = 1;
-        for (size_t j = i + 1; j < col; j++)
+        for (int i = 0; i < n; i++)
         {
-            relativity(i, j) = cov(i, j) / sqrt(vars[i] * vars[j]);
-            relativity(j, i) = relativity(i, j);
+            mat(i, j) = normal(rng) + j;
         }
     }
-    return relativity;
+    mat.col(d - 1) = mat.col(0) * 2 + mat.col(1);
+
+    auto start = std::chrono::steady_clock::now();
+    Eigen::MatrixXf centered = mat.rowwise() - mat.colwise().mean();
+    Eigen::MatrixXf reference = (centered.adjoint() * centered) / double(n - 1);
+    double seconds0 = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    Eigen::MatrixXf cov = getCovariance(mat);
+    Eigen::MatrixXf corr = getPearsonCorr(cov);
+    double seconds1 = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "covariance n=" << n << " d=" << d << ": product " << seconds0 << "s, blocked " << seconds1 << "s"
+              << ", max error " << (cov - reference).cwiseAbs().maxCoeff()
+              << ", symmetric " << (cov - cov.transpose()).cwiseAbs().maxCoeff()
+              << ", max |corr| " << corr.cwiseAbs().maxCoeff() << std::endl;
 }
 
-void testCovariance()
+inline void testCovariance()
 {
     std::vector<std::vector<float>> mat = {
         {1.2f, 2.3f, 3.4f, 8.8f},
@@ -85,6 +164,9 @@ void testCovariance()
     }
     auto rel = getPearsonCorr(cov, vars);
     std::cout << "pearson corr: \n" << rel << std::endl;
+
+    testCovarianceSpeed(100000, 50);
+    testCovarianceSpeed(20000, 600);
 }
 
 
@@ -1,48 +1,229 @@
+#ifndef DBSCAN_HPP
+#define DBSCAN_HPP
+
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <iostream>
+#include <random>
 #include <vector>
 
 #include "Eigen/Dense"
+#include "parallel.hpp"
+#include "spatial_index.hpp"
 
 using namespace Eigen;
 
-// 定义点的类型
-typedef std::vector<float> Point;
+// 尚未处理的点
+const int dbscanUnclassified = -2;
+// 噪声点
+const int dbscanNoise = -1;
+
+// DBSCAN主函数，样本为in的各行。近邻查询使用空间索引，
+// 低维时为网格，高维时为KD树，每次查询只检查epsilon附近的点。
+// 簇用队列逐层扩展，不会因簇过大而栈溢出；每个点的邻居只查询一次。
+// 先被判为噪声、之后被某个核心点覆盖的点归入该簇，作为边界点。
+// 若core不为空，写入每个点是否为核心点
+inline std::vector<int> dbscan(const Eigen::Ref<const Eigen::MatrixXf>& in,
+                        const float epsilon, const int minPts,
+                        std::vector<char>* core = nullptr) {
+  int numPoints = in.rows();
+  const SpatialIndex index(in, epsilon);
+
+  // cluster为分组标签，-1表示噪声点
+  std::vector<int> cluster(numPoints, dbscanUnclassified);
+  std::vector<char> isCore(numPoints, 0);
+  std::vector<int> queue;
+  std::vector<int> neighbors;
+  int clusterIdx = 0;
+
+  // 将核心点的邻居归入簇，未处理过的邻居入队
+  auto expand = [&](int idx) {
+    for (int neighborIdx : neighbors) {
+      if (cluster[neighborIdx] == dbscanNoise) {
+        cluster[neighborIdx] = clusterIdx;
+      } else if (cluster[neighborIdx] == dbscanUnclassified) {
+        cluster[neighborIdx] = clusterIdx;
+        queue.push_back(neighborIdx);
+      }
+    }
+    isCore[idx] = 1;
+  };
+
+  for (int i = 0; i < numPoints; ++i) {
+    if (cluster[i] != dbscanUnclassified) {
+      continue;
+    }
+
+    index.radiusNeighbors(i, neighbors);
+    if (neighbors.size() < static_cast<size_t>(minPts)) {
+      cluster[i] = dbscanNoise;
+      continue;
+    }
+
+    cluster[i] = clusterIdx;
+    queue.clear();
+    expand(i);
+    for (size_t head = 0; head < queue.size(); ++head) {
+      int idx = queue[head];
+      index.radiusNeighbors(idx, neighbors);
+      if (neighbors.size() >= static_cast<size_t>(minPts)) {
+        expand(idx);
+      }
+    }
+    clusterIdx++;
+  }
 
-// 计算两个点之间的欧氏距离
-float calculateDistance(const Point& p1, const Point& p2) {
-  float distance = 0.0;
-  for (size_t i = 0; i < p1.size(); ++i) {
-    float diff = p1[i] - p2[i];
-    distance += diff * diff;
+  if (core) {
+    *core = std::move(isCore);
   }
-  return std::sqrt(distance);
+  return cluster;
 }
 
-// 获取给定点的邻居
-std::vector<int> getNeighbors(const std::vector<Point>& dataset, int pointIdx,
-                              float epsilon) {
-  std::vector<int> neighbors;
-  for (size_t i = 0; i < dataset.size(); ++i) {
-    if (calculateDistance(dataset[pointIdx], dataset[i]) <= epsilon) {
-      neighbors.push_back(i);
+inline std::vector<int> dbscan(const std::vector<std::vector<float>>& in,
+                        const float epsilon, const int minPts) {
+  if (in.empty()) {
+    return {};
+  }
+  return dbscan(toMatrix(in), epsilon, minPts);
+}
+
+// 并行DBSCAN使用的并查集。合并时总是把序号较大的根接到较小的根上，
+// 父节点只会变小，因此可以用CAS无锁地合并和压缩路径，每个集合的根是其中最小的序号
+class ConcurrentUnionFind {
+ public:
+  explicit ConcurrentUnionFind(int n) : parent(n) {
+    for (int i = 0; i < n; ++i) {
+      parent[i].store(i, std::memory_order_relaxed);
+    }
+  }
+
+  int find(int x) {
+    while (true) {
+      int p = parent[x].load(std::memory_order_relaxed);
+      if (p == x) {
+        return x;
+      }
+      int gp = parent[p].load(std::memory_order_relaxed);
+      if (gp != p) {
+        // 路径减半，失败说明已被其他线程改小，忽略即可
+        parent[x].compare_exchange_weak(p, gp, std::memory_order_relaxed);
+      }
+      x = gp;
+    }
+  }
+
+  void unite(int a, int b) {
+    while (true) {
+      a = find(a);
+      b = find(b);
+      if (a == b) {
+        return;
+      }
+      if (a < b) {
+        std::swap(a, b);
+      }
+      int expected = a;
+      if (parent[a].compare_exchange_strong(expected, b, std::memory_order_relaxed)) {
+        return;
+      }
+    }
+  }
+
+ private:
+  std::vector<std::atomic<int>> parent;
+};
+
+// 每个并行任务处理的点数
+const int dbscanBlockSize = 1024;
+
+// 并行DBSCAN，结果与dbscan()的标签完全相同。分三步，每步在线程池上按点分块执行：
+// 1. 统计每个点的邻居数，确定核心点；
+// 2. 核心点与相邻的核心点在并查集中合并，每个连通分量即一个簇；
+// 3. 非核心点归入相邻核心点所在簇中编号最小的一个，没有则为噪声。
+// 簇按其中最小的核心点序号编号，与串行实现中簇被发现的顺序一致；
+// 串行实现中边界点归入最先扩展到它的簇，也就是编号最小的相邻簇。
+// threads为线程数，0表示使用全部硬件线程。
+// progress不为空时，每处理完一块调用progress(done, total)，total为点数的3倍，
+// 可能在多个线程中同时调用；返回false则取消，抛出TaskCancelled
+inline std::vector<int> dbscanParallel(const Eigen::Ref<const Eigen::MatrixXf>& in,
+                                const float epsilon, const int minPts,
+                                size_t threads = 0,
+                                const std::function<bool(long long, long long)>& progress = nullptr) {
+  int numPoints = in.rows();
+  const SpatialIndex index(in, epsilon);
+  const size_t numBlocks = (numPoints + dbscanBlockSize - 1) / dbscanBlockSize;
+  std::atomic<long long> done{0};
+  auto forEachBlock = [&](auto&& f) {
+    parallelFor(numBlocks, threads, [&](size_t block) {
+      int end = std::min<int>(numPoints, (block + 1) * dbscanBlockSize);
+      for (int i = block * dbscanBlockSize; i < end; ++i) {
+        f(i);
+      }
+      long long processed = done += end - block * dbscanBlockSize;
+      if (progress && !progress(processed, 3LL * numPoints)) {
+        throw TaskCancelled();
+      }
+    });
+  };
+
+  std::vector<char> isCore(numPoints, 0);
+  forEachBlock([&](int i) {
+    isCore[i] = index.countNeighbors(i) >= minPts;
+  });
+
+  ConcurrentUnionFind sets(numPoints);
+  forEachBlock([&](int i) {
+    if (!isCore[i]) {
+      return;
+    }
+    index.forEachNeighbor(i, [&](int j) {
+      if (j < i && isCore[j]) {
+        sets.unite(i, j);
+      }
+    });
+  });
+
+  // 按最小核心点序号的顺序为各簇编号
+  std::vector<int> cluster(numPoints, dbscanNoise);
+  int clusterIdx = 0;
+  for (int i = 0; i < numPoints; ++i) {
+    if (isCore[i]) {
+      int root = sets.find(i);
+      cluster[i] = root == i ? clusterIdx++ : cluster[root];
     }
   }
-  return neighbors;
+
+  forEachBlock([&](int i) {
+    if (isCore[i]) {
+      return;
+    }
+    int label = dbscanNoise;
+    index.forEachNeighbor(i, [&](int j) {
+      if (isCore[j] && (label == dbscanNoise || cluster[j] < label)) {
+        label = cluster[j];
+      }
+    });
+    cluster[i] = label;
+  });
+
+  return cluster;
 }
 
-// 执行DBSCAN算法
-void dbscanRecursive(const std::vector<Point>& dataset, int pointIdx,
-                     float epsilon, int minPts, std::vector<int>& cluster,
+// 原先的递归实现，仅用于benchmarkDbscan的对照。簇中的每个点各递归一层，
+// 大簇会栈溢出；先被判为噪声的点不会再归入之后的簇
+inline void dbscanRecursive(const SpatialIndex& index, int pointIdx,
+                     int minPts, std::vector<int>& cluster,
                      std::vector<int>& visited) {
   visited[pointIdx] = 1;
-  std::vector<int> neighbors = getNeighbors(dataset, pointIdx, epsilon);
+  std::vector<int> neighbors;
+  index.radiusNeighbors(pointIdx, neighbors);
 
   if (neighbors.size() >= static_cast<size_t>(minPts)) {
     for (size_t i = 0; i < neighbors.size(); ++i) {
       int neighborIdx = neighbors[i];
       if (!visited[neighborIdx]) {
-        dbscanRecursive(dataset, neighborIdx, epsilon, minPts, cluster,
-                        visited);
+        dbscanRecursive(index, neighborIdx, minPts, cluster, visited);
       }
     }
   }
@@ -50,33 +231,28 @@ void dbscanRecursive(const std::vector<Point>& dataset, int pointIdx,
   cluster.push_back(pointIdx);
 }
 
-// DBSCAN主函数
-std::vector<int> dbscan(const std::vector<std::vector<float>>& in,
-                        const float epsilon, const int minPts) {
-  // 将输入数据vector<vector<float>>转换为vector<Point>类型
-  int numPoints = in.size();
-  std::vector<Point> dataset(numPoints);
-  for (int i = 0; i < numPoints; ++i) {
-    dataset[i] = in[i];
-  }
+inline std::vector<int> dbscanLegacy(const Eigen::Ref<const Eigen::MatrixXf>& in,
+                              const float epsilon, const int minPts) {
+  int numPoints = in.rows();
+  const SpatialIndex index(in, epsilon);
 
-  // cluster为分组标签，-1表示噪声点
   std::vector<int> cluster(numPoints, -1);
   std::vector<int> visited(numPoints, 0);
   int clusterIdx = 0;
 
+  std::vector<int> neighbors;
   for (int i = 0; i < numPoints; ++i) {
     if (visited[i]) {
       continue;
     }
 
-    std::vector<int> neighbors = getNeighbors(dataset, i, epsilon);
+    index.radiusNeighbors(i, neighbors);
 
     if (neighbors.size() < static_cast<size_t>(minPts)) {
       visited[i] = 1;  // 标记为噪声点
     } else {
       std::vector<int> newCluster;
-      dbscanRecursive(dataset, i, epsilon, minPts, newCluster, visited);
+      dbscanRecursive(index, i, minPts, newCluster, visited);
 
       for (size_t j = 0; j < newCluster.size(); ++j) {
         cluster[newCluster[j]] = clusterIdx;
@@ -88,3 +264,68 @@ std::vector<int> dbscan(const std::vector<std::vector<float>>& in,
 
   return cluster;
 }
+
+// 在若干个高斯簇上比较队列实现与递归实现的标签和耗时。
+// 两者的簇编号顺序相同，核心点的标签应完全一致；
+// 差异只应是被递归实现留作噪声、被队列实现归入簇的边界点
+inline void benchmarkDbscan(int numPoints, int dim, float epsilon, int minPts) {
+  std::mt19937 rng(7);
+  std::normal_distribution<float> normal(0, 1);
+  Eigen::MatrixXf points(numPoints, dim);
+  for (int i = 0; i < numPoints; ++i) {
+    for (int k = 0; k < dim; ++k) {
+      points(i, k) = normal(rng) * 2 + (i % 5) * 8;
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<int> legacy = dbscanLegacy(points, epsilon, minPts);
+  auto middle = std::chrono::steady_clock::now();
+  std::vector<char> core;
+  std::vector<int> labels = dbscan(points, epsilon, minPts, &core);
+  auto end = std::chrono::steady_clock::now();
+  std::vector<int> parallelLabels = dbscanParallel(points, epsilon, minPts);
+  auto parallelEnd = std::chrono::steady_clock::now();
+
+  int coreMismatch = 0;
+  int borderRecovered = 0;
+  int otherMismatch = 0;
+  for (int i = 0; i < numPoints; ++i) {
+    if (labels[i] == legacy[i]) {
+      continue;
+    }
+    if (core[i]) {
+      coreMismatch++;
+    } else if (legacy[i] == dbscanNoise) {
+      borderRecovered++;
+    } else {
+      otherMismatch++;
+    }
+  }
+
+  std::cout << "dbscan n=" << numPoints << " dim=" << dim
+            << ": recursive " << std::chrono::duration<double>(middle - start).count() << "s"
+            << ", queue " << std::chrono::duration<double>(end - middle).count() << "s"
+            << ", parallel (" << hardwareThreads() << " threads) "
+            << std::chrono::duration<double>(parallelEnd - end).count() << "s"
+            << (parallelLabels == labels ? " same labels" : " DIFFERENT labels")
+            << ", core mismatches " << coreMismatch
+            << ", noise recovered as border " << borderRecovered
+            << ", other mismatches " << otherMismatch << std::endl;
+}
+
+inline void testDbscan() {
+  std::vector<std::vector<float>> points = {
+      {1, 1}, {1, 2}, {2, 1}, {2, 2}, {8, 8}, {8, 9}, {9, 8}, {9, 9}, {5, 5}};
+  std::vector<int> labels = dbscan(points, 1.5f, 3);
+  std::cout << "labels: \n";
+  for (int label : labels) {
+    std::cout << label << " ";
+  }
+  std::cout << std::endl;
+
+  benchmarkDbscan(20000, 2, 0.3f, 5);
+  benchmarkDbscan(20000, 5, 1.5f, 5);
+}
+
+#endif // DBSCAN_HPP
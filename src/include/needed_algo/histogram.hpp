@@ -0,0 +1,248 @@
+#ifndef HISTOGRAM_HPP
+#define HISTOGRAM_HPP
+
+#include "common.h"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+
+// 选择组数的规则
+enum class BinRule
+{
+    // ceil(log2 n) + 1，适合接近正态的小样本
+    sturges,
+    // 组宽3.49 * sigma * n^(-1/3)，对正态分布的积分均方误差最小
+    scott,
+    // 组宽2 * IQR * n^(-1/3)，用四分位距代替标准差，不受偏态和极端值影响
+    freedmanDiaconis,
+    // 使用给定的组数
+    fixed
+};
+
+// 规则得到的组数的上限，组太多时图表无法分辨
+const int histogramMaxBins = 256;
+// 每次用SIMD计算组号的元素数
+const size_t histogramBlockSize = 1024;
+// 每个并行任务处理的元素数
+const size_t histogramChunkSize = 1 << 16;
+
+// 等宽直方图：第i组为[edges[i], edges[i + 1])，最后一组包含右端点
+struct Histogram
+{
+    std::vector<double> edges;
+    std::vector<long long> counts;
+};
+
+// 按规则选择组数。n为样本数，stddev为标准差，iqr为四分位距，[lower, upper]为取值范围
+inline int histogramBins(BinRule rule, long long n, double stddev, double iqr, double lower, double upper,
+                         int fixedBins = 0)
+{
+    if (rule == BinRule::fixed)
+    {
+        return std::max(1, fixedBins);
+    }
+    if (n <= 1 || !(upper > lower))
+    {
+        return 1;
+    }
+
+    const int sturges = int(std::ceil(std::log2(double(n)))) + 1;
+    double width = 0;
+    if (rule == BinRule::scott)
+    {
+        width = 3.49 * stddev * std::cbrt(1.0 / n);
+    }
+    else if (rule == BinRule::freedmanDiaconis)
+    {
+        width = 2 * iqr * std::cbrt(1.0 / n);
+    }
+    // 标准差或四分位距为0（例如大部分取值相同）时退回Sturges
+    if (!(width > 0))
+    {
+        return std::min(sturges, histogramMaxBins);
+    }
+    const double bins = std::ceil((upper - lower) / width);
+    return int(std::max(1.0, std::min(bins, double(histogramMaxBins))));
+}
+
+// 把值计入[lower, upper]上的bins个等宽组，超出范围的值计入两端的组，NaN不计入。可以分多次add。
+// 组号按块用SIMD计算，计数分散到4份交错的计数数组，避免相同组号的连续自增互相等待
+class HistogramCounter
+{
+public:
+    HistogramCounter(int bins, double lower, double upper)
+        : bins(bins), stride(bins + 1), base(float(lower)),
+          scale(upper > lower ? float(bins / (upper - lower)) : 0.0f),
+          partial(4 * size_t(bins + 1), 0), idx(histogramBlockSize)
+    {
+    }
+
+    void add(const float *data, size_t n)
+    {
+        const float last = float(bins - 1);
+        for (size_t begin = 0; begin < n; begin += histogramBlockSize)
+        {
+            const Eigen::Index m = std::min(histogramBlockSize, n - begin);
+            Eigen::Map<const Eigen::ArrayXf> x(data + begin, m);
+            // NaN的组号为bins，最后丢弃
+            idx.head(m) = (x == x).select(((x - base) * scale).max(0.0f).min(last).cast<int>(), bins);
+            Eigen::Index i = 0;
+            for (; i + 4 <= m; i += 4)
+            {
+                partial[idx[i]]++;
+                partial[stride + idx[i + 1]]++;
+                partial[2 * stride + idx[i + 2]]++;
+                partial[3 * stride + idx[i + 3]]++;
+            }
+            for (; i < m; i++)
+            {
+                partial[idx[i]]++;
+            }
+        }
+    }
+
+    // 将各组的频次加到counts上，counts的长度为bins
+    void addTo(std::vector<long long> &counts) const
+    {
+        for (int bin = 0; bin < bins; bin++)
+        {
+            counts[bin] += partial[bin] + partial[stride + bin] + partial[2 * stride + bin] + partial[3 * stride + bin];
+        }
+    }
+
+private:
+    int bins;
+    int stride;
+    float base;
+    float scale;
+    std::vector<long long> partial;
+    Eigen::ArrayXi idx;
+};
+
+// 多线程统计直方图：每个任务有自己的计数数组，结束后按顺序相加
+inline Histogram histogramOf(const float *data, size_t n, double lower, double upper, int bins, size_t threads = 0)
+{
+    if (bins <= 0)
+    {
+        throw std::invalid_argument("bins <= 0");
+    }
+    const size_t cntChunks = (n + histogramChunkSize - 1) / histogramChunkSize;
+    std::vector<std::vector<long long>> chunks(cntChunks, std::vector<long long>(bins, 0));
+    parallelFor(cntChunks, threads, [&](size_t chunk)
+    {
+        const size_t begin = chunk * histogramChunkSize;
+        HistogramCounter counter(bins, lower, upper);
+        counter.add(data + begin, std::min(histogramChunkSize, n - begin));
+        counter.addTo(chunks[chunk]);
+    });
+
+    Histogram result;
+    result.counts.assign(bins, 0);
+    for (const auto &chunk : chunks)
+    {
+        for (int bin = 0; bin < bins; bin++)
+        {
+            result.counts[bin] += chunk[bin];
+        }
+    }
+    result.edges.resize(bins + 1);
+    for (int i = 0; i <= bins; i++)
+    {
+        result.edges[i] = lower + (upper - lower) * i / bins;
+    }
+    return result;
+}
+
+// 由[lower, upper]上的细分直方图fine合并出bins组，不再读取数据。第i组由细分的第
+// floor(i * F / bins)到floor((i + 1) * F / bins)组合并而成（F为细分组数），
+// 组的边界落在细分的边界上；bins整除F时各组等宽
+inline Histogram histogramRebin(const std::vector<long long> &fine, double lower, double upper, int bins)
+{
+    if (bins <= 0)
+    {
+        throw std::invalid_argument("bins <= 0");
+    }
+    const size_t cntFine = fine.size();
+    bins = std::min<size_t>(bins, std::max<size_t>(1, cntFine));
+
+    Histogram result;
+    result.counts.assign(bins, 0);
+    result.edges.resize(bins + 1);
+    for (int i = 0; i <= bins; i++)
+    {
+        const size_t boundary = cntFine * i / bins;
+        result.edges[i] = cntFine > 0 ? lower + (upper - lower) * boundary / cntFine : lower;
+        if (i < bins)
+        {
+            const size_t end = cntFine * (i + 1) / bins;
+            for (size_t f = boundary; f < end; f++)
+            {
+                result.counts[i] += fine[f];
+            }
+        }
+    }
+    return result;
+}
+
+// 比较各规则的组数，检查直接统计与由细分直方图合并的结果一致，并与逐个除法的标量版本比较耗时
+inline void testHistogram()
+{
+    const size_t n = 4000000;
+    std::mt19937 rng(47);
+    std::gamma_distribution<float> gamma(2, 3);
+    std::vector<float> x(n);
+    for (float &v : x)
+    {
+        v = gamma(rng);
+    }
+    x[5] = std::numeric_limits<float>::quiet_NaN();
+
+    const float lower = *std::min_element(x.begin() + 6, x.end());
+    const float upper = *std::max_element(x.begin() + 6, x.end());
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<long long> scalar(64, 0);
+    const double width = (upper - lower) / 64.0;
+    for (float v : x)
+    {
+        if (!std::isnan(v))
+        {
+            scalar[std::min(63, int((v - lower) / width))]++;
+        }
+    }
+    double scalarSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    Histogram direct = histogramOf(x.data(), n, lower, upper, 64);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    Histogram fine = histogramOf(x.data(), n, lower, upper, 2520);
+    Histogram rebinned = histogramRebin(fine.counts, lower, upper, 63);
+    long long total = 0;
+    for (long long c : rebinned.counts)
+    {
+        total += c;
+    }
+
+    long long maxDiff = 0;
+    for (int i = 0; i < 64; i++)
+    {
+        maxDiff = std::max(maxDiff, std::abs(direct.counts[i] - scalar[i]));
+    }
+    std::cout << "histogram scalar " << scalarSeconds << "s, blocked " << seconds << "s, max count difference "
+              << maxDiff << ", rebinned total " << total << " of " << n - 1 << std::endl;
+
+    const double stddev = std::sqrt(2.0) * 3;
+    const double iqr = 5.2;
+    std::cout << "bins sturges " << histogramBins(BinRule::sturges, n, stddev, iqr, lower, upper)
+              << ", scott " << histogramBins(BinRule::scott, n, stddev, iqr, lower, upper)
+              << ", freedman-diaconis " << histogramBins(BinRule::freedmanDiaconis, n, stddev, iqr, lower, upper)
+              << ", fd on 1000 samples " << histogramBins(BinRule::freedmanDiaconis, 1000, stddev, iqr, lower, upper)
+              << std::endl;
+}
+
+#endif // HISTOGRAM_HPP
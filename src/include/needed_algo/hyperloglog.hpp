@@ -0,0 +1,123 @@
+#ifndef HYPERLOGLOG_HPP
+#define HYPERLOGLOG_HPP
+
+#include "common.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+
+// 寄存器数为2^hllPrecision，估计的相对标准误差约为1.04 / sqrt(2^hllPrecision)，12时约1.6%
+const int hllPrecision = 12;
+
+// HyperLogLog（Flajolet et al. 2007）：用固定的2^hllPrecision个字节估计不同取值的个数。
+// 哈希值的高位选择寄存器，其余位中第一个1的位置越靠后，说明见过的不同值越多。
+// 两个sketch按寄存器取最大值即可合并，各线程分别统计后合并的结果与一起统计相同
+class HyperLogLog
+{
+public:
+    HyperLogLog() : registers(size_t(1) << hllPrecision, 0) {}
+
+    void addHash(uint64_t hash)
+    {
+        const size_t idx = hash >> (64 - hllPrecision);
+        uint64_t rest = hash << hllPrecision;
+        uint8_t rank = 1;
+        while (rank <= 64 - hllPrecision && !(rest & (uint64_t(1) << 63)))
+        {
+            rest <<= 1;
+            rank++;
+        }
+        registers[idx] = std::max(registers[idx], rank);
+    }
+
+    // NaN不计入，+0和-0视为同一个值
+    void add(float x)
+    {
+        if (std::isnan(x))
+        {
+            return;
+        }
+        if (x == 0)
+        {
+            x = 0;
+        }
+        uint32_t bits;
+        std::memcpy(&bits, &x, sizeof(bits));
+        addHash(mix(bits));
+    }
+
+    void merge(const HyperLogLog &other)
+    {
+        for (size_t i = 0; i < registers.size(); i++)
+        {
+            registers[i] = std::max(registers[i], other.registers[i]);
+        }
+    }
+
+    // 不同取值个数的估计。估计值较小且有空寄存器时改用线性计数，64位哈希不需要大范围修正
+    double estimate() const
+    {
+        const double m = registers.size();
+        double sum = 0;
+        size_t zeros = 0;
+        for (uint8_t r : registers)
+        {
+            sum += std::ldexp(1.0, -r);
+            zeros += r == 0;
+        }
+        const double alpha = 0.7213 / (1 + 1.079 / m);
+        const double raw = alpha * m * m / sum;
+        if (raw <= 2.5 * m && zeros > 0)
+        {
+            return m * std::log(m / zeros);
+        }
+        return raw;
+    }
+
+    // splitmix64的混合函数，相近的输入也得到分布均匀的64位哈希
+    static uint64_t mix(uint64_t x)
+    {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+private:
+    std::vector<uint8_t> registers;
+};
+
+// 对不同个数的取值输出估计值和相对误差，并检查分两半统计后合并的结果与一起统计相同
+inline void testHyperLogLog()
+{
+    std::mt19937 rng(41);
+    std::uniform_real_distribution<float> uniform(-1000, 1000);
+    for (int cnt : {10, 1000, 5000, 100000, 1000000})
+    {
+        std::vector<float> values(cnt);
+        for (float &v : values)
+        {
+            v = uniform(rng);
+        }
+        std::sort(values.begin(), values.end());
+        const size_t distinct = std::unique(values.begin(), values.end()) - values.begin();
+
+        HyperLogLog all, left, right;
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            // 每个值重复加入，重复不影响估计
+            all.add(values[i]);
+            all.add(values[i]);
+            (i % 2 ? left : right).add(values[i]);
+        }
+        left.merge(right);
+        std::cout << "hyperloglog distinct " << distinct << ": estimate " << all.estimate()
+                  << ", error " << (all.estimate() - distinct) / distinct
+                  << ", merged equal " << (left.estimate() == all.estimate()) << std::endl;
+    }
+}
+
+#endif // HYPERLOGLOG_HPP
@@ -0,0 +1,159 @@
+#ifndef INCREMENTAL_PCA_HPP
+#define INCREMENTAL_PCA_HPP
+
+#include "pca.hpp"
+
+// 增量主成分分析（Ross et al. 2008，与scikit-learn的IncrementalPCA相同）。
+// 每次partialFit接收一批样本，更新均值，并对
+//     [上一次的奇异值 * 主成分; 中心化的本批样本; 均值修正行]
+// 这个(r + m + 1) * d的小矩阵做SVD得到新的低秩基，样本只需读一遍，不必同时放在内存中。
+// 内部多保留pcaOversampling个方向，被截断的方差较少，前k个主成分更接近一次性分解的结果。
+class IncrementalPca
+{
+public:
+    explicit IncrementalPca(int k);
+
+    // 用一批样本（每行为一个样本）更新均值和主成分，各批的列数必须相同
+    void partialFit(const Eigen::Ref<const Eigen::MatrixXf> &batch);
+    void partialFit(const std::vector<std::vector<float>> &batch) { partialFit(toMatrix(batch)); }
+
+    // 样本在前k个主成分上的投影，可用于拟合之后新增的样本
+    Eigen::MatrixXf transform(const Eigen::Ref<const Eigen::MatrixXf> &mat) const;
+
+    long long samplesSeen() const { return nSeen; }
+    int dim() const { return d; }
+    // 已得到的主成分数，样本数或变量数不足k时小于k
+    int cntComponents() const { return std::min<int>(k, singular.size()); }
+
+    Eigen::RowVectorXf mean() const { return runningMean.cast<float>(); }
+    // 按PcaResult的约定返回均值、主成分和方差，scores为空
+    PcaResult result() const;
+
+private:
+    int k = 0;
+    int rank = 0;
+    int d = 0;
+    long long nSeen = 0;
+
+    // 均值在批数很多时用double累积，避免误差积累
+    Eigen::RowVectorXd runningMean;
+    // 每列为一个方向，按奇异值从大到小排列
+    Eigen::MatrixXf basis;
+    Eigen::VectorXf singular;
+};
+
+inline IncrementalPca::IncrementalPca(int _k) : k(_k)
+{
+    if (k <= 0)
+    {
+        throw std::invalid_argument("k <= 0");
+    }
+}
+
+inline void IncrementalPca::partialFit(const Eigen::Ref<const Eigen::MatrixXf> &batch)
+{
+    const long long m = batch.rows();
+    if (m == 0)
+    {
+        return;
+    }
+    if (nSeen == 0)
+    {
+        d = batch.cols();
+        rank = std::min(d, k + pcaOversampling);
+        runningMean = Eigen::RowVectorXd::Zero(d);
+    }
+    else if (batch.cols() != d)
+    {
+        throw std::invalid_argument("batch.cols() != dim()");
+    }
+
+    const Eigen::RowVectorXd batchMean = batch.cast<double>().colwise().mean();
+    const long long total = nSeen + m;
+    const int r = singular.size();
+
+    Eigen::MatrixXf stacked(r + m + (nSeen > 0 ? 1 : 0), d);
+    if (r > 0)
+    {
+        stacked.topRows(r) = singular.asDiagonal() * basis.transpose();
+    }
+    stacked.middleRows(r, m) = batch.rowwise() - batchMean.cast<float>();
+    if (nSeen > 0)
+    {
+        // 两批均值之差带来的方差，与Chan的合并公式相同
+        double scale = std::sqrt(double(nSeen) * m / total);
+        stacked.bottomRows(1) = ((runningMean - batchMean) * scale).cast<float>();
+    }
+
+    Eigen::BDCSVD<Eigen::MatrixXf> svd(stacked, Eigen::ComputeThinV);
+    const int kept = std::min<int>(rank, svd.singularValues().size());
+    basis = svd.matrixV().leftCols(kept);
+    singular = svd.singularValues().head(kept);
+    pcaFixSigns(basis);
+
+    runningMean += (batchMean - runningMean) * (double(m) / total);
+    nSeen = total;
+}
+
+inline Eigen::MatrixXf IncrementalPca::transform(const Eigen::Ref<const Eigen::MatrixXf> &mat) const
+{
+    if (nSeen == 0)
+    {
+        throw std::invalid_argument("samplesSeen() == 0");
+    }
+    if (mat.cols() != d)
+    {
+        throw std::invalid_argument("mat.cols() != dim()");
+    }
+    return (mat.rowwise() - mean()) * basis.leftCols(cntComponents());
+}
+
+inline PcaResult IncrementalPca::result() const
+{
+    PcaResult result;
+    result.mean = mean();
+    result.components = basis.leftCols(cntComponents());
+    result.variances = singular.head(cntComponents()).array().square() / float(std::max<long long>(1, nSeen - 1));
+    return result;
+}
+
+// 以一次性分解的结果为准，按batch行一批地拟合，比较方差相对误差、主成分夹角的余弦，
+// 以及拟合后新增样本的投影误差
+inline void testIncrementalPca(int n, int d, int k, int batch)
+{
+    Eigen::MatrixXf mat = pcaTestMatrix(n, d, 29);
+
+    // 最后一批不参与拟合，当作新增的样本
+    const int fitted = n - batch;
+    PcaResult reference = pcaDecompose(mat.topRows(fitted), k, PcaMethod::full);
+
+    auto start = std::chrono::steady_clock::now();
+    IncrementalPca ipca(k);
+    for (int begin = 0; begin < fitted; begin += batch)
+    {
+        ipca.partialFit(mat.middleRows(begin, std::min(batch, fitted - begin)));
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    PcaResult result = ipca.result();
+    float meanError = (result.mean - reference.mean).cwiseAbs().maxCoeff();
+    float varianceError = ((result.variances - reference.variances).cwiseQuotient(reference.variances)).cwiseAbs().maxCoeff();
+    float minCosine = (result.components.adjoint() * reference.components).diagonal().minCoeff();
+
+    Eigen::MatrixXf appended = mat.bottomRows(batch);
+    Eigen::MatrixXf expected = (appended.rowwise() - reference.mean) * reference.components;
+    float scoreError = (ipca.transform(appended) - expected).norm() / expected.norm();
+
+    std::cout << "incremental n=" << n << " d=" << d << " k=" << k << " batch=" << batch << ": " << seconds << "s"
+              << ", mean error " << meanError << ", variance error " << varianceError
+              << ", min cosine " << minCosine << ", appended score error " << scoreError << std::endl;
+}
+
+inline void testIncrementalPCA()
+{
+    testIncrementalPca(2000, 30, 3, 100);
+    testIncrementalPca(20000, 200, 3, 1000);
+    testIncrementalPca(5000, 50, 8, 7);
+}
+
+#endif // INCREMENTAL_PCA_HPP
@@ -0,0 +1,329 @@
+#ifndef KLL_HPP
+#define KLL_HPP
+
+#include "common.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <random>
+
+// KLL的精度参数。k = 200时单个分位数的秩误差以99%的概率不超过约1.3%，
+// 保存的值约为3k个，与数据量几乎无关
+const int kllDefaultK = 200;
+// 相邻两层容量的比例
+const double kllCapacityRatio = 2.0 / 3.0;
+
+// 单个分位数的秩误差以99%的概率不超过该值（Apache DataSketches对KLL的经验公式）
+inline double kllRankError(int k)
+{
+    return 2.296 / std::pow(double(k), 0.9723);
+}
+
+// KLL分位数sketch（Karnin, Lang, Liberty 2016）。第h层的每个值代表2^h个原始值，
+// 某一层超过容量时排序，随机取奇数位或偶数位上的一半移到上一层。
+// 两个sketch逐层拼接后再压缩即可合并，可以各线程分别统计后合并。NaN不计入
+class KllSketch
+{
+public:
+    explicit KllSketch(int k = kllDefaultK, uint32_t seed = 0);
+
+    void add(float x);
+    void merge(const KllSketch &other);
+
+    bool empty() const { return n == 0; }
+    long long count() const { return n; }
+    float min() const { return minValue; }
+    float max() const { return maxValue; }
+    // 保存的值的个数
+    size_t retained() const { return cntRetained; }
+    double rankError() const { return kllRankError(k); }
+
+    // 第q分位数，q取值为[0, 1]，0和1分别为精确的最小值和最大值
+    float quantile(double q) const { return quantiles({q})[0]; }
+    // 多个分位数只排序一次
+    std::vector<float> quantiles(const std::vector<double> &qs) const;
+    // 不超过x的值所占的比例
+    double rank(float x) const;
+
+private:
+    int k;
+    long long n = 0;
+    float minValue = 0;
+    float maxValue = 0;
+    // 决定压缩时保留哪一半，固定种子使结果可重复
+    std::minstd_rand coin;
+    // levels[h]为第h层的值，capacities[h]为其容量
+    std::vector<std::vector<float>> levels;
+    std::vector<size_t> capacities;
+    size_t cntRetained = 0;
+    size_t cntCapacity = 0;
+
+    void updateCapacities();
+    void compress();
+    std::vector<std::pair<float, uint64_t>> weightedValues() const;
+};
+
+inline KllSketch::KllSketch(int _k, uint32_t seed) : k(_k), coin(seed + 1), levels(1)
+{
+    if (k < 8)
+    {
+        throw std::invalid_argument("k < 8");
+    }
+    updateCapacities();
+}
+
+// 最高层的容量为k，往下每层乘以kllCapacityRatio，至少为2。层数变化时重新计算
+inline void KllSketch::updateCapacities()
+{
+    capacities.resize(levels.size());
+    cntCapacity = 0;
+    for (size_t h = 0; h < levels.size(); h++)
+    {
+        const double depth = double(levels.size() - 1 - h);
+        capacities[h] = std::max<size_t>(2, size_t(std::ceil(k * std::pow(kllCapacityRatio, depth))));
+        cntCapacity += capacities[h];
+    }
+}
+
+inline void KllSketch::add(float x)
+{
+    if (std::isnan(x))
+    {
+        return;
+    }
+    if (n == 0)
+    {
+        minValue = maxValue = x;
+    }
+    else
+    {
+        minValue = std::min(minValue, x);
+        maxValue = std::max(maxValue, x);
+    }
+    n++;
+    levels[0].push_back(x);
+    cntRetained++;
+    if (cntRetained >= cntCapacity)
+    {
+        compress();
+    }
+}
+
+// 总数达到各层容量之和时，压缩最低的一个达到容量的层，直到总数低于容量之和。
+// 新的值都先放在第0层，第0层积累到较多时才排序压缩一次，每个值的均摊代价为O(log k)
+inline void KllSketch::compress()
+{
+    while (cntRetained >= cntCapacity)
+    {
+        size_t h = 0;
+        while (h < levels.size() && levels[h].size() < capacities[h])
+        {
+            h++;
+        }
+        if (h == levels.size())
+        {
+            break;
+        }
+        if (h + 1 == levels.size())
+        {
+            levels.emplace_back();
+            updateCapacities();
+        }
+
+        std::vector<float> &level = levels[h];
+        std::sort(level.begin(), level.end());
+        // 个数为奇数时留下最后一个，其余的一半移到上一层
+        const size_t paired = level.size() & ~size_t(1);
+        const size_t offset = coin() & 1;
+        std::vector<float> &upper = levels[h + 1];
+        for (size_t i = offset; i < paired; i += 2)
+        {
+            upper.push_back(level[i]);
+        }
+        cntRetained -= paired / 2;
+        if (paired < level.size())
+        {
+            level[0] = level.back();
+            level.resize(1);
+        }
+        else
+        {
+            level.clear();
+        }
+    }
+}
+
+inline void KllSketch::merge(const KllSketch &other)
+{
+    if (other.n == 0)
+    {
+        return;
+    }
+    if (n == 0)
+    {
+        minValue = other.minValue;
+        maxValue = other.maxValue;
+    }
+    else
+    {
+        minValue = std::min(minValue, other.minValue);
+        maxValue = std::max(maxValue, other.maxValue);
+    }
+    n += other.n;
+    if (levels.size() < other.levels.size())
+    {
+        levels.resize(other.levels.size());
+    }
+    for (size_t h = 0; h < other.levels.size(); h++)
+    {
+        levels[h].insert(levels[h].end(), other.levels[h].begin(), other.levels[h].end());
+    }
+    cntRetained += other.cntRetained;
+    updateCapacities();
+    compress();
+}
+
+// 按值排序的(值, 权重)，权重为2^层数
+inline std::vector<std::pair<float, uint64_t>> KllSketch::weightedValues() const
+{
+    std::vector<std::pair<float, uint64_t>> values;
+    values.reserve(retained());
+    for (size_t h = 0; h < levels.size(); h++)
+    {
+        for (float x : levels[h])
+        {
+            values.emplace_back(x, uint64_t(1) << h);
+        }
+    }
+    std::sort(values.begin(), values.end());
+    return values;
+}
+
+inline std::vector<float> KllSketch::quantiles(const std::vector<double> &qs) const
+{
+    if (n == 0)
+    {
+        throw std::invalid_argument("n == 0");
+    }
+
+    const auto values = weightedValues();
+    uint64_t total = 0;
+    for (const auto &value : values)
+    {
+        total += value.second;
+    }
+
+    std::vector<float> result;
+    result.reserve(qs.size());
+    for (double q : qs)
+    {
+        if (!(q >= 0 && q <= 1))
+        {
+            throw std::invalid_argument("q < 0 || q > 1");
+        }
+        if (q == 0)
+        {
+            result.push_back(minValue);
+            continue;
+        }
+        if (q == 1)
+        {
+            result.push_back(maxValue);
+            continue;
+        }
+        // 累计权重首次达到q * total的值
+        const double target = q * total;
+        uint64_t cumulative = 0;
+        float answer = maxValue;
+        for (const auto &value : values)
+        {
+            cumulative += value.second;
+            if (cumulative >= target)
+            {
+                answer = value.first;
+                break;
+            }
+        }
+        result.push_back(answer);
+    }
+    return result;
+}
+
+inline double KllSketch::rank(float x) const
+{
+    if (n == 0)
+    {
+        throw std::invalid_argument("n == 0");
+    }
+    uint64_t below = 0;
+    uint64_t total = 0;
+    for (size_t h = 0; h < levels.size(); h++)
+    {
+        for (float value : levels[h])
+        {
+            total += uint64_t(1) << h;
+            if (value <= x)
+            {
+                below += uint64_t(1) << h;
+            }
+        }
+    }
+    return double(below) / total;
+}
+
+// 对偏态分布比较sketch与精确排序的分位数，输出秩误差、保存的值的个数和耗时，
+// 并检查分8段统计后合并的结果与精确值同样接近
+inline void testKll()
+{
+    const size_t n = 2000000;
+    std::mt19937 rng(43);
+    std::lognormal_distribution<float> lognormal(0, 1);
+    std::vector<float> x(n);
+    for (float &v : x)
+    {
+        v = lognormal(rng);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    KllSketch sketch;
+    for (float v : x)
+    {
+        sketch.add(v);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    KllSketch merged;
+    for (int part = 0; part < 8; part++)
+    {
+        KllSketch partial(kllDefaultK, part);
+        for (size_t i = part * n / 8; i < (part + 1) * n / 8; i++)
+        {
+            partial.add(x[i]);
+        }
+        merged.merge(partial);
+    }
+
+    std::vector<float> sorted = x;
+    start = std::chrono::steady_clock::now();
+    std::sort(sorted.begin(), sorted.end());
+    double sortSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const std::vector<double> qs = {0.01, 0.25, 0.5, 0.75, 0.99};
+    for (const KllSketch *s : {&sketch, &merged})
+    {
+        const auto estimates = s->quantiles(qs);
+        double maxRankError = 0;
+        for (size_t i = 0; i < qs.size(); i++)
+        {
+            double trueRank = double(std::upper_bound(sorted.begin(), sorted.end(), estimates[i]) - sorted.begin()) / n;
+            maxRankError = std::max(maxRankError, std::abs(trueRank - qs[i]));
+        }
+        std::cout << "kll median " << estimates[2] << " (exact " << sorted[n / 2] << ")"
+                  << ", max rank error " << maxRankError << ", retained " << s->retained() << std::endl;
+    }
+    std::cout << "kll build " << seconds << "s, sort " << sortSeconds << "s" << std::endl;
+}
+
+#endif // KLL_HPP
@@ -2,104 +2,1336 @@
 #define KMENAS_HPP
 
 #include "common.h"
+#include "parallel.hpp"
 
-std::tuple<Eigen::MatrixXf, std::vector<int>>
-clusterKMeans(const std::vector<std::vector<float>> &in, const int k, const int maxIter)
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <random>
+#include <tuple>
+
+// 分配步骤的算法。hamerly和elkan用三角不等式维护每个样本到中心距离的上下界，
+// 界足以确定最近的中心时跳过距离计算，得到的分组与逐个计算距离相同
+enum class KMeansAlgorithm
+{
+    // 分块用矩阵乘法计算全部距离。距离几乎相等的样本可能因舍入误差与其他算法分到不同的组
+    lloyd,
+    // 每个样本保存到最近中心的上界和到其余中心的一个下界，适合k较小时
+    hamerly,
+    // 每个样本保存到每个中心的下界，k较大时跳过更多计算，但需要n*k的内存
+    elkan,
+    automatic
+};
+
+// 初始中心的选取方法
+enum class KMeansInit
+{
+    // 均匀随机选取k个样本
+    random,
+    // k-means++：依次按到已选中心距离的平方加权抽样
+    plusPlus,
+    // k-means||：每轮并行地过采样约2k个候选，若干轮后在加权的候选上做k-means++，
+    // 只需遍历数据几次。距离计算约为k-means++的10倍，只在线程很多时更快
+    parallel,
+    // 选择k-means++
+    automatic
+};
+
+// 每轮迭代结束时报告的进度
+struct KMeansProgress
+{
+    // 第几次运行，以及本次运行已完成的轮数
+    int restart = 0;
+    int iteration = 0;
+    int cntChanged = 0;
+    // 本轮分组相对更新前中心的惯性，需要再遍历一次全部样本，只在要显示时调用；
+    // mini-batch为按批惯性估计的全部样本的惯性
+    std::function<double()> inertia;
+    // 本轮的分组，mini-batch为nullptr
+    const std::vector<int> *labels = nullptr;
+};
+
+// 满足任一收敛条件即停止：分组不再变化；全部中心移动距离的平方和不超过
+// tolerance乘以各特征方差的均值；inertiaTolerance大于0时，惯性的相对变化不超过它
+struct KMeansOptions
+{
+    int k = 4;
+    int maxIter = 100;
+    KMeansAlgorithm algorithm = KMeansAlgorithm::automatic;
+    float tolerance = 1e-4f;
+    // 需要每轮额外计算n个距离，默认不启用
+    float inertiaTolerance = 0;
+    KMeansInit init = KMeansInit::automatic;
+    // 用不同的初始中心重复运行的次数，各次在线程池上并发执行，取惯性最小的结果
+    int nInit = 1;
+    // 第r次运行的随机数由(seed, r)决定，相同的参数总得到相同的结果
+    unsigned int seed = 0;
+    // 线程数，0表示使用全部硬件线程。先分给并发的各次运行，剩余的用于每次运行内部的分块，
+    // 分块与线程数无关，结果不随线程数改变
+    size_t threads = 0;
+    // kmeansMiniBatch每步抽取的样本数，此时maxIter为最多的步数
+    int batchSize = 1024;
+    // 不为空时每轮结束后调用，返回false则取消，kmeans抛出TaskCancelled。
+    // 并发的各次运行会在各自的线程中调用它，需要自行保证线程安全
+    std::function<bool(const KMeansProgress &)> onProgress;
+};
+
+struct KMeansResult
+{
+    Eigen::MatrixXf centers;
+    std::vector<int> labels;
+    int iterations = 0;
+    bool converged = false;
+    // 各样本到所属中心距离的平方和
+    double inertia = 0;
+    // 样本到中心的距离计算次数，以及借助上下界省去的次数
+    long long distanceComputations = 0;
+    long long distancesSkipped = 0;
+    // 计算的距离中由矩阵乘法分块得到的次数
+    long long distancesBlocked = 0;
+};
+
+// k不超过该值时automatic选择hamerly
+const int kmeansHamerlyMaxK = 16;
+// elkan下界数量的上限，超过时automatic改用hamerly
+const long long kmeansElkanMaxBounds = 1LL << 25;
+// 用界排除中心时留出的相对余量，抵消浮点舍入。距离可能相等时总是实际计算，
+// 与lloyd一样取序号最小的中心
+const float kmeansBoundSlack = 1e-4f;
+
+// k-means||的轮数，以及每轮期望采样的候选数与k之比
+const int kmeansParallelInitRounds = 5;
+const int kmeansParallelInitOversampling = 2;
+// k-means||并行处理时每块的样本数
+const int kmeansParallelInitChunkRows = 1 << 12;
+// 分块用矩阵乘法计算距离时每块的样本数。块内的坐标和距离矩阵共约block * (col + k)个float，
+// 能留在二级缓存中，累加坐标和时不必再从内存读取样本
+const int kmeansBlockRows = 256;
+
+// 按行存放的矩阵，每个样本或中心的坐标在内存中连续
+typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> KMeansRowMatrix;
+
+inline float kmeansSquaredDistance(const float *x, const float *c, int d)
+{
+    float dist = 0;
+    for (int t = 0; t < d; t++)
+    {
+        float diff = x[t] - c[t];
+        dist += diff * diff;
+    }
+    return dist;
+}
+
+inline float kmeansDistance(const float *x, const float *c, int d)
+{
+    return std::sqrt(kmeansSquaredDistance(x, c, d));
+}
+
+// bound大于upper且留有余量时，该界对应的中心不可能比当前中心更近
+inline bool kmeansExcludes(float bound, float upper)
+{
+    return bound > upper * (1 + kmeansBoundSlack);
+}
+
+// 各组样本坐标之和与样本数，用于更新中心
+struct KMeansSums
 {
-    if (in.empty())
+    Eigen::MatrixXd sums;
+    std::vector<long long> counts;
+
+    KMeansSums(int k, int col) : sums(Eigen::MatrixXd::Zero(k, col)), counts(k, 0) {}
+
+    void add(const KMeansRowMatrix &points, int i, int label)
     {
-        throw std::invalid_argument("in.empty()");
+        sums.row(label) += points.row(i).cast<double>();
+        counts[label]++;
     }
+};
 
-    if (k <= 0)
+// 由各组的坐标和计算中心，空的组保留原中心。返回各中心移动的距离
+inline std::vector<float> kmeansMoveCenters(const KMeansSums &sums, KMeansRowMatrix &centers)
+{
+    const int k = centers.rows();
+    const int col = centers.cols();
+    std::vector<float> moves(k, 0);
+    for (int j = 0; j < k; j++)
     {
-        throw std::invalid_argument("k <= 0");
+        if (sums.counts[j] == 0)
+        {
+            continue;
+        }
+        Eigen::RowVectorXf center = (sums.sums.row(j) / double(sums.counts[j])).cast<float>();
+        moves[j] = kmeansDistance(center.data(), centers.row(j).data(), col);
+        centers.row(j) = center;
     }
+    return moves;
+}
 
-    if (maxIter <= 0)
+// 由分组重新计算中心，空的组保留原中心。返回各中心移动的距离
+inline std::vector<float> kmeansUpdateCenters(const KMeansRowMatrix &points, const std::vector<int> &labels,
+                                              KMeansRowMatrix &centers)
+{
+    KMeansSums sums(centers.rows(), centers.cols());
+    for (int i = 0; i < points.rows(); i++)
     {
-        throw std::invalid_argument("maxIter <= 0");
+        sums.add(points, i, labels[i]);
     }
+    return kmeansMoveCenters(sums, centers);
+}
 
-    int row = in.size();
-    int col = in[0].size();
+// 各样本到所属中心距离的平方和
+inline double kmeansInertia(const KMeansRowMatrix &points, const std::vector<int> &labels, const KMeansRowMatrix &centers)
+{
+    double inertia = 0;
+    for (int i = 0; i < points.rows(); i++)
+    {
+        inertia += kmeansSquaredDistance(points.row(i).data(), centers.row(labels[i]).data(), points.cols());
+    }
+    return inertia;
+}
 
-    Eigen::MatrixXf mat(row, col);
+// 按weights[i] * dist2[i]的比例抽取一个序号。权重全为0时均匀抽取
+inline int kmeansSampleWeighted(const std::vector<double> &dist2, const std::vector<double> *weights, std::mt19937 &rng)
+{
+    const int n = dist2.size();
+    double total = 0;
+    for (int i = 0; i < n; i++)
+    {
+        total += weights ? (*weights)[i] * dist2[i] : dist2[i];
+    }
+    if (!(total > 0))
+    {
+        return std::uniform_int_distribution<int>(0, n - 1)(rng);
+    }
+
+    double target = std::uniform_real_distribution<double>(0, total)(rng);
+    double sum = 0;
+    int last = 0;
+    for (int i = 0; i < n; i++)
+    {
+        double w = weights ? (*weights)[i] * dist2[i] : dist2[i];
+        if (w <= 0)
+        {
+            continue;
+        }
+        sum += w;
+        last = i;
+        if (sum > target)
+        {
+            return i;
+        }
+    }
+    return last;
+}
+
+// 在points的各行上做k-means++，weights不为空时为各样本的权重。返回所选样本的序号
+inline std::vector<int> kmeansPlusPlus(const KMeansRowMatrix &points, int k, const std::vector<double> *weights,
+                                       std::mt19937 &rng)
+{
+    const int row = points.rows();
+    const int col = points.cols();
+    // 到已选中心的最小距离的平方，初始时各样本等概率
+    std::vector<double> dist2(row, 1);
+    std::vector<int> chosen;
+    chosen.reserve(k);
+    for (int j = 0; j < k; j++)
+    {
+        int idx = kmeansSampleWeighted(dist2, weights, rng);
+        chosen.push_back(idx);
+        for (int i = 0; i < row; i++)
+        {
+            double dist = kmeansSquaredDistance(points.row(i).data(), points.row(idx).data(), col);
+            dist2[i] = j == 0 ? dist : std::min(dist2[i], dist);
+        }
+    }
+    return chosen;
+}
+
+// k-means||：先均匀选一个中心，之后每轮各样本以l * d^2 / cost的概率独立地成为候选，
+// 其中l = 2k，d为到已有候选的最小距离，cost为d^2之和。
+// 候选以最近的样本数为权重，再用k-means++选出k个。
+// 样本按kmeansParallelInitChunkRows分块，在threads个线程上更新距离、求cost和抽样，
+// 每块的抽样使用由(本轮的种子, 块号)决定的随机数，结果与线程数无关
+inline std::vector<int> kmeansParallelInit(const KMeansRowMatrix &points, int k, std::mt19937 &rng, size_t threads = 1)
+{
+    const int row = points.rows();
+    const int col = points.cols();
+    const size_t cntChunks = (row + kmeansParallelInitChunkRows - 1) / kmeansParallelInitChunkRows;
+    std::vector<int> candidates{std::uniform_int_distribution<int>(0, row - 1)(rng)};
+    std::vector<double> dist2(row, std::numeric_limits<double>::max());
+    std::vector<int> nearest(row, 0);
+    std::vector<double> chunkCosts(cntChunks, 0);
+
+    // 用candidates[from, end)更新各样本到候选的最小距离，并求各块的d^2之和。
+    // 块内按kmeansBlockRows行用一次矩阵乘法计算到新候选的距离
+    auto updateDistances = [&](size_t from)
+    {
+        KMeansRowMatrix added(candidates.size() - from, col);
+        for (size_t c = from; c < candidates.size(); c++)
+        {
+            added.row(c - from) = points.row(candidates[c]);
+        }
+        const Eigen::RowVectorXf addedNorms = added.rowwise().squaredNorm().transpose();
+        parallelFor(cntChunks, threads, [&](size_t chunk)
+        {
+            const int chunkBegin = chunk * kmeansParallelInitChunkRows;
+            const int chunkEnd = std::min(row, chunkBegin + kmeansParallelInitChunkRows);
+            KMeansRowMatrix dots;
+            double cost = 0;
+            for (int begin = chunkBegin; begin < chunkEnd; begin += kmeansBlockRows)
+            {
+                const int end = std::min(chunkEnd, begin + kmeansBlockRows);
+                const auto block = points.middleRows(begin, end - begin);
+                dots.noalias() = block * added.transpose();
+                for (int i = begin; i < end; i++)
+                {
+                    const float norm = points.row(i).squaredNorm();
+                    const float *dot = dots.row(i - begin).data();
+                    for (Eigen::Index c = 0; c < added.rows(); c++)
+                    {
+                        double dist = std::max(0.0f, norm + addedNorms[c] - 2 * dot[c]);
+                        if (dist < dist2[i])
+                        {
+                            dist2[i] = dist;
+                            nearest[i] = from + c;
+                        }
+                    }
+                    cost += dist2[i];
+                }
+            }
+            chunkCosts[chunk] = cost;
+        });
+    };
+    updateDistances(0);
+
+    const double oversampling = double(kmeansParallelInitOversampling) * k;
+    std::vector<std::vector<int>> sampled(cntChunks);
+    for (int round = 0; round < kmeansParallelInitRounds; round++)
+    {
+        double cost = 0;
+        for (double chunkCost : chunkCosts)
+        {
+            cost += chunkCost;
+        }
+        if (!(cost > 0))
+        {
+            break;
+        }
+        const unsigned int roundSeed = rng();
+        parallelFor(cntChunks, threads, [&](size_t chunk)
+        {
+            std::seed_seq seq{roundSeed, (unsigned int)chunk};
+            std::mt19937 chunkRng(seq);
+            std::uniform_real_distribution<double> uniform(0, 1);
+            const int end = std::min<int>(row, (chunk + 1) * kmeansParallelInitChunkRows);
+            sampled[chunk].clear();
+            for (int i = chunk * kmeansParallelInitChunkRows; i < end; i++)
+            {
+                if (uniform(chunkRng) < oversampling * dist2[i] / cost)
+                {
+                    sampled[chunk].push_back(i);
+                }
+            }
+        });
+        size_t from = candidates.size();
+        for (const std::vector<int> &chunk : sampled)
+        {
+            candidates.insert(candidates.end(), chunk.begin(), chunk.end());
+        }
+        if (candidates.size() > from)
+        {
+            updateDistances(from);
+        }
+    }
+
+    std::vector<double> weights(candidates.size(), 0);
     for (int i = 0; i < row; i++)
     {
-        if (in[i].size() != static_cast<size_t>(col))
+        weights[nearest[i]]++;
+    }
+    KMeansRowMatrix candidatePoints(candidates.size(), col);
+    for (size_t c = 0; c < candidates.size(); c++)
+    {
+        candidatePoints.row(c) = points.row(candidates[c]);
+    }
+
+    // 候选不足k个时，其余中心均匀抽取
+    std::vector<int> chosen;
+    for (int c : kmeansPlusPlus(candidatePoints, std::min<int>(k, candidates.size()), &weights, rng))
+    {
+        chosen.push_back(candidates[c]);
+    }
+    while ((int)chosen.size() < k)
+    {
+        chosen.push_back(std::uniform_int_distribution<int>(0, row - 1)(rng));
+    }
+    return chosen;
+}
+
+inline KMeansRowMatrix kmeansSeed(const KMeansRowMatrix &points, int k, KMeansInit init, std::mt19937 &rng,
+                                  size_t threads = 1)
+{
+    const int row = points.rows();
+    std::vector<int> chosen;
+    switch (init)
+    {
+    case KMeansInit::random:
+        for (int j = 0; j < k; j++)
         {
-            throw std::invalid_argument("in[i].size() != col");
+            chosen.push_back(std::uniform_int_distribution<int>(0, row - 1)(rng));
         }
-        for (int j = 0; j < col; j++)
+        break;
+    case KMeansInit::parallel:
+        chosen = kmeansParallelInit(points, k, rng, threads);
+        break;
+    default:
+        chosen = kmeansPlusPlus(points, k, nullptr, rng);
+        break;
+    }
+
+    KMeansRowMatrix centers(k, points.cols());
+    for (int j = 0; j < k; j++)
+    {
+        centers.row(j) = points.row(chosen[j]);
+    }
+    return centers;
+}
+
+// 一次运行的收敛判断和进度报告的状态
+struct KMeansConvergence
+{
+    // 中心移动距离平方和的阈值
+    double shiftTolerance = 0;
+    double inertiaTolerance = 0;
+    double lastInertia = -1;
+    const std::function<bool(const KMeansProgress &)> *onProgress = nullptr;
+    int restart = 0;
+};
+
+// 一轮分配之后更新中心，并判断是否收敛。cntChanged为本轮分组改变的样本数，
+// moves写入各中心移动的距离。sums不为空时为分配时已累加好的坐标和。返回true时应停止迭代
+inline bool kmeansStep(const KMeansRowMatrix &points, KMeansRowMatrix &centers, int cntChanged,
+                       KMeansConvergence &convergence, std::vector<float> &moves, KMeansResult &result,
+                       const KMeansSums *sums = nullptr)
+{
+    result.iterations++;
+    if (convergence.onProgress && *convergence.onProgress)
+    {
+        KMeansProgress progress;
+        progress.restart = convergence.restart;
+        progress.iteration = result.iterations;
+        progress.cntChanged = cntChanged;
+        progress.inertia = [&]()
+        {
+            result.distanceComputations += points.rows();
+            return kmeansInertia(points, result.labels, centers);
+        };
+        progress.labels = &result.labels;
+        if (!(*convergence.onProgress)(progress))
         {
-            mat(i, j) = in[i][j];
+            throw TaskCancelled();
         }
     }
 
-    Eigen::MatrixXf centers(k, col);
-    std::vector<int> labels(row);
-    std::vector<int> counts(k);
-    std::vector<int> oldLabels(row);
+    if (cntChanged == 0)
+    {
+        moves.assign(centers.rows(), 0);
+        result.converged = true;
+        return true;
+    }
 
-    // init centers
-    for (int i = 0; i < k; i++)
+    moves = sums ? kmeansMoveCenters(*sums, centers) : kmeansUpdateCenters(points, result.labels, centers);
+    double shift = 0;
+    for (float move : moves)
     {
-        int idx = rand() % row;
-        for (int j = 0; j < col; j++)
+        shift += double(move) * move;
+    }
+    if (shift <= convergence.shiftTolerance)
+    {
+        result.converged = true;
+        return true;
+    }
+
+    if (convergence.inertiaTolerance > 0)
+    {
+        double inertia = kmeansInertia(points, result.labels, centers);
+        result.distanceComputations += points.rows();
+        bool stable = convergence.lastInertia >= 0
+                      && std::abs(convergence.lastInertia - inertia) <= convergence.inertiaTolerance * convergence.lastInertia;
+        convergence.lastInertia = inertia;
+        if (stable)
+        {
+            result.converged = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+// 每个中心到最近的其他中心距离的一半。样本到当前中心的距离不超过它时，当前中心一定最近
+inline std::vector<float> kmeansHalfSeparation(const KMeansRowMatrix &centers, Eigen::MatrixXf *centerDistances)
+{
+    const int k = centers.rows();
+    const int col = centers.cols();
+    std::vector<float> half(k, std::numeric_limits<float>::max());
+    for (int j = 0; j < k; j++)
+    {
+        for (int l = j + 1; l < k; l++)
+        {
+            float dist = kmeansDistance(centers.row(j).data(), centers.row(l).data(), col);
+            if (centerDistances)
+            {
+                (*centerDistances)(j, l) = (*centerDistances)(l, j) = dist;
+            }
+            half[j] = std::min(half[j], dist / 2);
+            half[l] = std::min(half[l], dist / 2);
+        }
+    }
+    return half;
+}
+
+// 将points[begin, end)分配到最近的中心，并把坐标累加到sums。返回分组改变的样本数。
+// 距离的平方按||x||^2 - 2x·c + ||c||^2计算，其中x·c由一次矩阵乘法得到；
+// ||x||^2对同一样本是常数，比较时省去，也不需要开方。dots为复用的缓冲区
+inline int kmeansAssignBlock(const KMeansRowMatrix &points, int begin, int end, const KMeansRowMatrix &centers,
+                             const Eigen::RowVectorXf &centerNorms, KMeansRowMatrix &dots,
+                             std::vector<int> &labels, KMeansSums &sums)
+{
+    const int k = centers.rows();
+    dots.resize(end - begin, k);
+    dots.noalias() = points.middleRows(begin, end - begin) * centers.transpose();
+
+    int cntChanged = 0;
+    for (int i = begin; i < end; i++)
+    {
+        const float *dot = dots.row(i - begin).data();
+        float minDist = std::numeric_limits<float>::max();
+        int minIdx = 0;
+        for (int j = 0; j < k; j++)
+        {
+            float dist = centerNorms[j] - 2 * dot[j];
+            if (dist < minDist)
+            {
+                minDist = dist;
+                minIdx = j;
+            }
+        }
+        cntChanged += labels[i] != minIdx;
+        labels[i] = minIdx;
+        sums.add(points, i, minIdx);
+    }
+    return cntChanged;
+}
+
+// 矩阵乘法得到的距离平方的舍入误差不超过(||x||^2 + ||c||^2) * (col + 2) * FLT_EPSILON的这么多倍
+const float kmeansBlockErrorFactor = 4;
+
+// 用矩阵乘法计算block各行到全部中心距离的下界，写入bounds的各行。
+// 按||x||^2 - 2x·c + ||c||^2计算的距离平方减去舍入误差的上界后再开方，不超过实际距离
+inline void kmeansLowerBoundsBlock(const Eigen::Ref<const KMeansRowMatrix> &block, const KMeansRowMatrix &centers,
+                                   const Eigen::RowVectorXf &centerNorms, KMeansRowMatrix &bounds)
+{
+    const int col = block.cols();
+    bounds.resize(block.rows(), centers.rows());
+    bounds.noalias() = block * centers.transpose();
+    const Eigen::VectorXf pointNorms = block.rowwise().squaredNorm();
+    const float maxCenterNorm = centerNorms.maxCoeff();
+    const float relError = kmeansBlockErrorFactor * (col + 2) * std::numeric_limits<float>::epsilon();
+    for (Eigen::Index r = 0; r < block.rows(); r++)
+    {
+        const float slack = relError * (pointNorms[r] + maxCenterNorm);
+        bounds.row(r) = ((pointNorms[r] - slack) + centerNorms.array() - 2 * bounds.row(r).array()).max(0.0f).sqrt();
+    }
+}
+
+// 由样本x到各中心距离的下界bounds确定实际最近的中心：先实际计算下界最小的中心，
+// 再实际计算下界不能排除的其余中心，这些中心的下界更新为实际距离。
+// 距离相等时与lloyd一样取序号较小的中心。dist写入到最近中心的距离，computed加上实际计算的次数
+inline int kmeansResolveNearest(const float *x, const KMeansRowMatrix &centers, float *bounds, float &dist,
+                                long long &computed)
+{
+    const int k = centers.rows();
+    const int col = centers.cols();
+    int first = 0;
+    for (int j = 1; j < k; j++)
+    {
+        if (bounds[j] < bounds[first])
         {
-            centers(i, j) = mat(idx, j);
+            first = j;
         }
     }
+    int best = first;
+    dist = bounds[first] = kmeansDistance(x, centers.row(first).data(), col);
+    computed++;
+    for (int j = 0; j < k; j++)
+    {
+        if (j == first || kmeansExcludes(bounds[j], dist))
+        {
+            continue;
+        }
+        float distJ = kmeansDistance(x, centers.row(j).data(), col);
+        bounds[j] = distJ;
+        computed++;
+        if (distJ < dist || (distJ == dist && j < best))
+        {
+            best = j;
+            dist = distJ;
+        }
+    }
+    return best;
+}
+
+// 多线程时分块的样本数，每块有自己的坐标和与计数
+const int kmeansChunkRows = 16 * kmeansBlockRows;
+
+// 一块样本在一轮分配中的结果
+struct KMeansChunk
+{
+    KMeansSums sums;
+    int cntChanged = 0;
+    long long computed = 0;
+    long long skipped = 0;
+    long long blocked = 0;
+
+    KMeansChunk(int k, int col) : sums(k, col) {}
+};
+
+// 将[0, row)按kmeansChunkRows分块，在threads个线程上对每块调用f(begin, end, chunk)，
+// 再按块的顺序依次合并各块的结果。分块方式和合并顺序与线程数无关，
+// 浮点数的累加顺序固定，因此任意线程数下的结果都逐位相同
+template <typename F>
+KMeansChunk kmeansForEachChunk(int row, int k, int col, size_t threads, F &&f)
+{
+    const size_t cntChunks = (row + kmeansChunkRows - 1) / kmeansChunkRows;
+    std::vector<KMeansChunk> chunks(cntChunks, KMeansChunk(k, col));
+    parallelFor(cntChunks, threads, [&](size_t c)
+    {
+        int begin = c * kmeansChunkRows;
+        int end = std::min<int>(row, begin + kmeansChunkRows);
+        f(begin, end, chunks[c]);
+    });
+
+    KMeansChunk total(k, col);
+    for (const KMeansChunk &chunk : chunks)
+    {
+        total.sums.sums += chunk.sums.sums;
+        for (int j = 0; j < k; j++)
+        {
+            total.sums.counts[j] += chunk.sums.counts[j];
+        }
+        total.cntChanged += chunk.cntChanged;
+        total.computed += chunk.computed;
+        total.skipped += chunk.skipped;
+        total.blocked += chunk.blocked;
+    }
+    return total;
+}
 
-    int iter = 0;
-    while (iter < maxIter)
+// 在threads个线程上对[0, row)的每个样本调用f(i)，各样本互不影响
+template <typename F>
+void kmeansForEachRow(int row, size_t threads, F &&f)
+{
+    const size_t cntChunks = (row + kmeansChunkRows - 1) / kmeansChunkRows;
+    parallelFor(cntChunks, threads, [&](size_t c)
+    {
+        int end = std::min<int>(row, (c + 1) * kmeansChunkRows);
+        for (int i = c * kmeansChunkRows; i < end; i++)
+        {
+            f(i);
+        }
+    });
+}
+
+// 把一轮分配的统计计入result，再更新中心并判断是否收敛
+inline bool kmeansFinishIteration(const KMeansRowMatrix &points, KMeansRowMatrix &centers, const KMeansChunk &total,
+                                  KMeansConvergence &convergence, std::vector<float> &moves, KMeansResult &result)
+{
+    result.distanceComputations += total.computed;
+    result.distancesSkipped += total.skipped;
+    result.distancesBlocked += total.blocked;
+    return kmeansStep(points, centers, total.cntChanged, convergence, moves, result, &total.sums);
+}
+
+// 各算法对样本分块，块内的分配和坐标累加在同一线程中完成；threads为线程数，0表示全部硬件线程
+inline void kmeansLloyd(const KMeansRowMatrix &points, KMeansRowMatrix &centers, int maxIter, size_t threads,
+                        KMeansConvergence &convergence, KMeansResult &result)
+{
+    const int row = points.rows();
+    const int k = centers.rows();
+    const int col = points.cols();
+    std::vector<float> moves;
+
+    for (int iter = 0; iter < maxIter; iter++)
     {
         // assign labels
-        for (int i = 0; i < row; i++)
+        Eigen::RowVectorXf centerNorms = centers.rowwise().squaredNorm().transpose();
+        KMeansChunk total = kmeansForEachChunk(row, k, col, threads, [&](int chunkBegin, int chunkEnd, KMeansChunk &chunk)
+        {
+            KMeansRowMatrix dots;
+            for (int begin = chunkBegin; begin < chunkEnd; begin += kmeansBlockRows)
+            {
+                int end = std::min(chunkEnd, begin + kmeansBlockRows);
+                chunk.cntChanged += kmeansAssignBlock(points, begin, end, centers, centerNorms, dots, result.labels, chunk.sums);
+            }
+            chunk.computed += (long long)(chunkEnd - chunkBegin) * k;
+            chunk.blocked += (long long)(chunkEnd - chunkBegin) * k;
+        });
+
+        // update centers
+        if (kmeansFinishIteration(points, centers, total, convergence, moves, result))
+        {
+            break;
+        }
+    }
+}
+
+inline void kmeansHamerly(const KMeansRowMatrix &points, KMeansRowMatrix &centers, int maxIter, size_t threads,
+                          KMeansConvergence &convergence, KMeansResult &result)
+{
+    const int row = points.rows();
+    const int k = centers.rows();
+    const int col = points.cols();
+    std::vector<int> &labels = result.labels;
+
+    // 到所属中心距离的上界，到其余中心距离的下界
+    std::vector<float> upper(row);
+    std::vector<float> lower(row);
+    std::vector<float> moves;
+
+    // 由矩阵乘法得到block各行到全部中心距离的下界，确定最近的中心。上界为到它的实际距离，
+    // 下界为到其余中心的下界中最小的。rows[r]为block第r行的样本序号
+    auto assignBlock = [&](const Eigen::Ref<const KMeansRowMatrix> &block, const int *rows,
+                           const Eigen::RowVectorXf &centerNorms, KMeansRowMatrix &bounds, KMeansChunk &chunk)
+    {
+        const int m = block.rows();
+        kmeansLowerBoundsBlock(block, centers, centerNorms, bounds);
+        for (int r = 0; r < m; r++)
         {
-            float minDist = std::numeric_limits<float>::max();
-            int minIdx = -1;
+            const int i = rows[r];
+            float *dist = bounds.row(r).data();
+            int label = kmeansResolveNearest(block.row(r).data(), centers, dist, upper[i], chunk.computed);
+            float second = std::numeric_limits<float>::max();
             for (int j = 0; j < k; j++)
             {
-                float dist = (mat.row(i) - centers.row(j)).norm();
-                if (dist < minDist)
+                if (j != label)
                 {
-                    minDist = dist;
-                    minIdx = j;
+                    second = std::min(second, dist[j]);
                 }
             }
-            labels[i] = minIdx;
+            chunk.cntChanged += labels[i] != label;
+            labels[i] = label;
+            lower[i] = second;
         }
+        chunk.computed += (long long)m * k;
+        chunk.blocked += (long long)m * k;
+    };
 
-        // update centers
-        centers.setZero();
-        counts.assign(k, 0);
-        for (int i = 0; i < row; i++)
+    for (int iter = 0; iter < maxIter; iter++)
+    {
+        std::vector<float> half;
+        if (iter > 0)
+        {
+            half = kmeansHalfSeparation(centers, nullptr);
+        }
+        const Eigen::RowVectorXf centerNorms = centers.rowwise().squaredNorm().transpose();
+        KMeansChunk total = kmeansForEachChunk(row, k, col, threads, [&](int chunkBegin, int chunkEnd, KMeansChunk &chunk)
+        {
+            KMeansRowMatrix bounds;
+            KMeansRowMatrix gathered;
+            std::vector<int> pending;
+            for (int begin = chunkBegin; begin < chunkEnd; begin += kmeansBlockRows)
+            {
+                int end = std::min(chunkEnd, begin + kmeansBlockRows);
+                pending.clear();
+                if (iter == 0)
+                {
+                    for (int i = begin; i < end; i++)
+                    {
+                        pending.push_back(i);
+                    }
+                    assignBlock(points.middleRows(begin, end - begin), pending.data(), centerNorms, bounds, chunk);
+                }
+                else
+                {
+                    // 界不能确定最近中心的样本集中起来，用一次矩阵乘法重新计算
+                    for (int i = begin; i < end; i++)
+                    {
+                        float bound = std::max(half[labels[i]], lower[i]);
+                        if (kmeansExcludes(bound, upper[i]))
+                        {
+                            chunk.skipped += k;
+                            continue;
+                        }
+                        upper[i] = kmeansDistance(points.row(i).data(), centers.row(labels[i]).data(), col);
+                        chunk.computed++;
+                        if (kmeansExcludes(bound, upper[i]))
+                        {
+                            chunk.skipped += k - 1;
+                        }
+                        else
+                        {
+                            pending.push_back(i);
+                        }
+                    }
+                    if (!pending.empty())
+                    {
+                        gathered.resize(pending.size(), col);
+                        for (size_t r = 0; r < pending.size(); r++)
+                        {
+                            gathered.row(r) = points.row(pending[r]);
+                        }
+                        assignBlock(gathered, pending.data(), centerNorms, bounds, chunk);
+                    }
+                }
+                for (int i = begin; i < end; i++)
+                {
+                    chunk.sums.add(points, i, labels[i]);
+                }
+            }
+        });
+
+        if (kmeansFinishIteration(points, centers, total, convergence, moves, result))
+        {
+            break;
+        }
+
+        float maxMove = 0;
+        for (float move : moves)
+        {
+            maxMove = std::max(maxMove, move);
+        }
+        kmeansForEachRow(row, threads, [&](int i)
+        {
+            upper[i] += moves[labels[i]];
+            lower[i] -= maxMove;
+        });
+    }
+}
+
+inline void kmeansElkan(const KMeansRowMatrix &points, KMeansRowMatrix &centers, int maxIter, size_t threads,
+                        KMeansConvergence &convergence, KMeansResult &result)
+{
+    const int row = points.rows();
+    const int k = centers.rows();
+    const int col = points.cols();
+    std::vector<int> &labels = result.labels;
+
+    // 到所属中心距离的上界，到每个中心距离的下界（按样本存放，每个样本k个）
+    std::vector<float> upper(row);
+    std::vector<float> lower((size_t)row * k);
+    Eigen::MatrixXf centerDistances = Eigen::MatrixXf::Zero(k, k);
+    std::vector<float> moves;
+
+    // 第一轮由矩阵乘法得到到全部中心距离的下界，再确定最近的中心
+    auto assignFirst = [&](int chunkBegin, int chunkEnd, KMeansChunk &chunk)
+    {
+        const Eigen::RowVectorXf centerNorms = centers.rowwise().squaredNorm().transpose();
+        KMeansRowMatrix block;
+        for (int begin = chunkBegin; begin < chunkEnd; begin += kmeansBlockRows)
+        {
+            int end = std::min(chunkEnd, begin + kmeansBlockRows);
+            kmeansLowerBoundsBlock(points.middleRows(begin, end - begin), centers, centerNorms, block);
+            for (int i = begin; i < end; i++)
+            {
+                float *bounds = &lower[(size_t)i * k];
+                Eigen::Map<Eigen::RowVectorXf>(bounds, k) = block.row(i - begin);
+                int best = kmeansResolveNearest(points.row(i).data(), centers, bounds, upper[i], chunk.computed);
+                chunk.cntChanged += labels[i] != best;
+                labels[i] = best;
+                chunk.sums.add(points, i, best);
+            }
+        }
+        chunk.computed += (long long)(chunkEnd - chunkBegin) * k;
+        chunk.blocked += (long long)(chunkEnd - chunkBegin) * k;
+    };
+
+    // 之后只计算界不能排除的中心
+    std::vector<float> half;
+    auto assignBounded = [&](int i, KMeansChunk &chunk)
+    {
+        int label = labels[i];
+        float dist = upper[i];
+        if (kmeansExcludes(half[label], dist))
+        {
+            chunk.skipped += k;
+            return;
+        }
+
+        float *bounds = &lower[(size_t)i * k];
+        bool stale = true;
+        int computed = 0;
+        for (int j = 0; j < k; j++)
+        {
+            if (j == label
+                || kmeansExcludes(bounds[j], dist)
+                || kmeansExcludes(centerDistances(label, j) / 2, dist))
+            {
+                continue;
+            }
+            if (stale)
+            {
+                dist = kmeansDistance(points.row(i).data(), centers.row(label).data(), col);
+                bounds[label] = dist;
+                computed++;
+                stale = false;
+                if (kmeansExcludes(bounds[j], dist) || kmeansExcludes(centerDistances(label, j) / 2, dist))
+                {
+                    continue;
+                }
+            }
+            float distJ = kmeansDistance(points.row(i).data(), centers.row(j).data(), col);
+            bounds[j] = distJ;
+            computed++;
+            // 距离相等时与lloyd一样取序号较小的中心
+            if (distJ < dist || (distJ == dist && j < label))
+            {
+                label = j;
+                dist = distJ;
+            }
+        }
+        chunk.cntChanged += labels[i] != label;
+        labels[i] = label;
+        upper[i] = dist;
+        chunk.computed += computed;
+        chunk.skipped += k - computed;
+    };
+
+    for (int iter = 0; iter < maxIter; iter++)
+    {
+        if (iter > 0)
+        {
+            half = kmeansHalfSeparation(centers, &centerDistances);
+        }
+        KMeansChunk total = kmeansForEachChunk(row, k, col, threads, [&](int begin, int end, KMeansChunk &chunk)
+        {
+            if (iter == 0)
+            {
+                assignFirst(begin, end, chunk);
+                return;
+            }
+            for (int i = begin; i < end; i++)
+            {
+                assignBounded(i, chunk);
+                chunk.sums.add(points, i, labels[i]);
+            }
+        });
+
+        if (kmeansFinishIteration(points, centers, total, convergence, moves, result))
+        {
+            break;
+        }
+
+        kmeansForEachRow(row, threads, [&](int i)
+        {
+            upper[i] += moves[labels[i]];
+            float *bounds = &lower[(size_t)i * k];
+            for (int j = 0; j < k; j++)
+            {
+                bounds[j] = std::max(0.0f, bounds[j] - moves[j]);
+            }
+        });
+    }
+}
+
+inline void kmeansCheckOptions(const Eigen::Ref<const Eigen::MatrixXf> &mat, const KMeansOptions &options)
+{
+    if (mat.rows() == 0)
+    {
+        throw std::invalid_argument("mat.rows() == 0");
+    }
+
+    if (options.k <= 0)
+    {
+        throw std::invalid_argument("k <= 0");
+    }
+
+    if (options.maxIter <= 0)
+    {
+        throw std::invalid_argument("maxIter <= 0");
+    }
+
+    if (options.nInit <= 0)
+    {
+        throw std::invalid_argument("nInit <= 0");
+    }
+}
+
+// 样本为mat的各行
+inline KMeansResult kmeans(const Eigen::Ref<const Eigen::MatrixXf> &mat, const KMeansOptions &options)
+{
+    kmeansCheckOptions(mat, options);
+
+    const int row = mat.rows();
+    const int col = mat.cols();
+    const int k = options.k;
+
+    // 先减去均值，结果不变，但lloyd按||x||^2 - 2x·c + ||c||^2计算距离时，
+    // 坐标的绝对值越小，抵消造成的舍入误差越小
+    const Eigen::RowVectorXf mean = mat.colwise().mean();
+    const KMeansRowMatrix points = mat.rowwise() - mean;
+
+    // 中心移动的阈值与数据的尺度成正比
+    KMeansConvergence convergence;
+    double meanVariance = col > 0 ? points.squaredNorm() / (double(row) * col) : 0;
+    convergence.shiftTolerance = options.tolerance * meanVariance;
+    convergence.inertiaTolerance = options.inertiaTolerance;
+    convergence.onProgress = &options.onProgress;
+
+    KMeansAlgorithm algorithm = options.algorithm;
+    if (algorithm == KMeansAlgorithm::automatic)
+    {
+        algorithm = k <= kmeansHamerlyMaxK || (long long)row * k > kmeansElkanMaxBounds
+                        ? KMeansAlgorithm::hamerly
+                        : KMeansAlgorithm::elkan;
+    }
+
+    const size_t threads = options.threads == 0 ? hardwareThreads() : options.threads;
+    const size_t outerThreads = std::min<size_t>(threads, options.nInit);
+    const size_t innerThreads = std::max<size_t>(1, threads / outerThreads);
+
+    std::vector<KMeansResult> results(options.nInit);
+    parallelFor(options.nInit, outerThreads, [&](size_t r)
+    {
+        std::seed_seq seq{options.seed, (unsigned int)r};
+        std::mt19937 rng(seq);
+        KMeansRowMatrix centers = kmeansSeed(points, k, options.init, rng, innerThreads);
+        KMeansConvergence state = convergence;
+        state.restart = r;
+        KMeansResult &result = results[r];
+        result.labels.assign(row, -1);
+        switch (algorithm)
+        {
+        case KMeansAlgorithm::lloyd:
+            kmeansLloyd(points, centers, options.maxIter, innerThreads, state, result);
+            break;
+        case KMeansAlgorithm::elkan:
+            kmeansElkan(points, centers, options.maxIter, innerThreads, state, result);
+            break;
+        default:
+            kmeansHamerly(points, centers, options.maxIter, innerThreads, state, result);
+            break;
+        }
+        result.inertia = kmeansInertia(points, result.labels, centers);
+        result.centers = centers.rowwise() + mean;
+    });
+
+    // 惯性相同时取序号较小的一次，结果与线程调度无关
+    size_t best = 0;
+    for (size_t r = 1; r < results.size(); r++)
+    {
+        if (results[r].inertia < results[best].inertia)
         {
-            centers.row(labels[i]) += mat.row(i);
-            counts[labels[i]]++;
+            best = r;
         }
-        for (int i = 0; i < k; i++)
+    }
+    return std::move(results[best]);
+}
+
+// kmeansMiniBatch中，批惯性的滑动平均连续这么多步没有下降时停止
+const int kmeansMiniBatchMaxNoImprovement = 10;
+// 滑动平均中新一批所占的权重
+const double kmeansMiniBatchSmoothing = 0.1;
+
+// Mini-batch K-means，适合样本很多、完整迭代太慢时。每步有放回地随机抽取batchSize个样本，
+// 分配到最近的中心后，每个中心朝本批分到它的样本的均值移动。中心j的学习率为
+// 本批分到它的样本数 / 至今分到它的样本总数，越往后移动越小。
+// 初始中心在3 * batchSize个样本的子集上选取，nInit次中取子集上惯性最小的一组。
+// 每步的中心移动含有抽样噪声，不使用tolerance，而是在批惯性的滑动平均
+// 连续kmeansMiniBatchMaxNoImprovement步没有下降时停止。
+// 最后对全部样本做一次分配得到labels和inertia
+inline KMeansResult kmeansMiniBatch(const Eigen::Ref<const Eigen::MatrixXf> &mat, const KMeansOptions &options)
+{
+    kmeansCheckOptions(mat, options);
+    if (options.batchSize <= 0)
+    {
+        throw std::invalid_argument("batchSize <= 0");
+    }
+
+    const int row = mat.rows();
+    const int col = mat.cols();
+    const int k = options.k;
+
+    const Eigen::RowVectorXf mean = mat.colwise().mean();
+    const KMeansRowMatrix points = mat.rowwise() - mean;
+
+    std::mt19937 rng(options.seed);
+    std::uniform_int_distribution<int> pick(0, row - 1);
+
+    // 在子集上选取初始中心
+    const int initSize = std::min<long long>(row, std::max<long long>(3LL * options.batchSize, k));
+    KMeansRowMatrix subset(initSize, col);
+    for (int i = 0; i < initSize; i++)
+    {
+        subset.row(i) = points.row(initSize == row ? i : pick(rng));
+    }
+    KMeansRowMatrix centers;
+    double bestInertia = std::numeric_limits<double>::max();
+    for (int r = 0; r < options.nInit; r++)
+    {
+        KMeansRowMatrix candidate = kmeansSeed(subset, k, options.init, rng);
+        std::vector<int> labels(initSize, -1);
+        KMeansSums sums(k, col);
+        KMeansRowMatrix dots;
+        kmeansAssignBlock(subset, 0, initSize, candidate, candidate.rowwise().squaredNorm().transpose(), dots, labels, sums);
+        double inertia = kmeansInertia(subset, labels, candidate);
+        if (inertia < bestInertia)
+        {
+            bestInertia = inertia;
+            centers = candidate;
+        }
+    }
+
+    KMeansResult result;
+    KMeansRowMatrix batch(options.batchSize, col);
+    KMeansRowMatrix dots;
+    std::vector<int> batchLabels(options.batchSize);
+    std::vector<long long> counts(k, 0);
+    double smoothedInertia = -1;
+    double bestSmoothed = std::numeric_limits<double>::max();
+    int cntNoImprovement = 0;
+    for (int step = 0; step < options.maxIter; step++)
+    {
+        for (int i = 0; i < options.batchSize; i++)
+        {
+            batch.row(i) = points.row(pick(rng));
+        }
+        KMeansSums sums(k, col);
+        kmeansAssignBlock(batch, 0, options.batchSize, centers, centers.rowwise().squaredNorm().transpose(), dots, batchLabels, sums);
+        double batchInertia = kmeansInertia(batch, batchLabels, centers) / options.batchSize;
+        result.distanceComputations += (long long)options.batchSize * k;
+        result.iterations++;
+
+        for (int j = 0; j < k; j++)
         {
-            if (counts[i] > 0)
+            if (sums.counts[j] == 0)
             {
-                centers.row(i) /= float(counts[i]);
+                continue;
             }
+            counts[j] += sums.counts[j];
+            Eigen::RowVectorXd move = (sums.sums.row(j) - sums.counts[j] * centers.row(j).cast<double>()) / double(counts[j]);
+            centers.row(j) += move.cast<float>();
         }
-        ++iter;
 
+        smoothedInertia = smoothedInertia < 0
+                              ? batchInertia
+                              : (1 - kmeansMiniBatchSmoothing) * smoothedInertia + kmeansMiniBatchSmoothing * batchInertia;
+        if (options.onProgress)
+        {
+            KMeansProgress progress;
+            progress.iteration = result.iterations;
+            const double estimated = smoothedInertia * row;
+            progress.inertia = [estimated]()
+            {
+                return estimated;
+            };
+            if (!options.onProgress(progress))
+            {
+                throw TaskCancelled();
+            }
+        }
+        if (smoothedInertia < bestSmoothed)
+        {
+            bestSmoothed = smoothedInertia;
+            cntNoImprovement = 0;
+        }
+        else if (++cntNoImprovement >= kmeansMiniBatchMaxNoImprovement)
+        {
+            result.converged = true;
+            break;
+        }
     }
-    return { centers, labels };
+
+    // 对全部样本做最后一次分配
+    result.labels.assign(row, -1);
+    Eigen::RowVectorXf centerNorms = centers.rowwise().squaredNorm().transpose();
+    kmeansForEachChunk(row, k, col, options.threads, [&](int chunkBegin, int chunkEnd, KMeansChunk &chunk)
+    {
+        KMeansRowMatrix chunkDots;
+        for (int begin = chunkBegin; begin < chunkEnd; begin += kmeansBlockRows)
+        {
+            int end = std::min(chunkEnd, begin + kmeansBlockRows);
+            kmeansAssignBlock(points, begin, end, centers, centerNorms, chunkDots, result.labels, chunk.sums);
+        }
+    });
+    result.distanceComputations += (long long)row * k;
+    result.inertia = kmeansInertia(points, result.labels, centers);
+    result.centers = centers.rowwise() + mean;
+    return result;
 }
 
-std::tuple<Eigen::MatrixXf, std::vector<int>>
+// 样本为mat的各行
+inline std::tuple<Eigen::MatrixXf, std::vector<int>>
+clusterKMeans(const Eigen::Ref<const Eigen::MatrixXf> &mat, const int k, const int maxIter)
+{
+    KMeansOptions options;
+    options.k = k;
+    options.maxIter = maxIter;
+    KMeansResult result = kmeans(mat, options);
+    return { result.centers, result.labels };
+}
+
+inline std::tuple<Eigen::MatrixXf, std::vector<int>>
+clusterKMeans(const std::vector<std::vector<float>> &in, const int k, const int maxIter)
+{
+    return clusterKMeans(toMatrix(in), k, maxIter);
+}
+
+inline std::tuple<Eigen::MatrixXf, std::vector<int>>
 clusterKMeans(const std::vector<std::vector<float>> &in, const int k)
 {
     return clusterKMeans(in, k, 100);
 }
 
-void testCluster()
+// 同样的初始中心下比较三种分配算法的分组，并输出省去的距离计算比例
+inline void testKMeansAlgorithms(int row, int col, int k)
+{
+    std::mt19937 rng(11);
+    std::normal_distribution<float> normal(0, 1);
+    Eigen::MatrixXf mat(row, col);
+    for (int i = 0; i < row; i++)
+    {
+        for (int j = 0; j < col; j++)
+        {
+            mat(i, j) = normal(rng) + (i % 7) * 3 * (j % 2 ? 1 : -1);
+        }
+    }
+
+    KMeansOptions options;
+    options.k = k;
+    options.maxIter = 30;
+    options.tolerance = 0;
+    KMeansResult results[3];
+    const KMeansAlgorithm algorithms[3] = {KMeansAlgorithm::lloyd, KMeansAlgorithm::hamerly, KMeansAlgorithm::elkan};
+    const char *names[3] = {"lloyd", "hamerly", "elkan"};
+    for (int a = 0; a < 3; a++)
+    {
+        options.algorithm = algorithms[a];
+        results[a] = kmeans(mat, options);
+        long long total = results[a].distanceComputations + results[a].distancesSkipped;
+        std::cout << names[a] << " k=" << k << ": computed " << results[a].distanceComputations
+                  << ", skipped " << results[a].distancesSkipped
+                  << " (" << (total ? 100.0 * results[a].distancesSkipped / total : 0) << "%)"
+                  << ", " << results[a].iterations << " iterations, inertia " << results[a].inertia
+                  << (results[a].labels == results[0].labels ? ", same labels as lloyd" : ", DIFFERENT labels")
+                  << std::endl;
+    }
+
+    // 默认的automatic也应经过矩阵乘法的分块距离计算
+    options.algorithm = KMeansAlgorithm::automatic;
+    KMeansResult automatic = kmeans(mat, options);
+    std::cout << "automatic k=" << k << ": " << automatic.distancesBlocked << " of " << automatic.distanceComputations
+              << " distances blocked" << (automatic.distancesBlocked > 0 ? "" : ", BLOCKED KERNEL NOT REACHED")
+              << std::endl;
+}
+
+// 比较各种初始化方法的迭代次数和惯性，以及多次重启的效果；同样的seed应得到同样的分组
+inline void testKMeansInit(int row, int col, int k)
+{
+    std::mt19937 rng(13);
+    std::normal_distribution<float> normal(0, 1);
+    Eigen::MatrixXf mat(row, col);
+    for (int i = 0; i < row; i++)
+    {
+        for (int j = 0; j < col; j++)
+        {
+            mat(i, j) = normal(rng) + (i % k) * 4 * (j % 3 ? 1 : -1);
+        }
+    }
+
+    KMeansOptions options;
+    options.k = k;
+    const KMeansInit inits[3] = {KMeansInit::random, KMeansInit::plusPlus, KMeansInit::parallel};
+    const char *names[3] = {"random", "k-means++", "k-means||"};
+    for (int a = 0; a < 3; a++)
+    {
+        options.init = inits[a];
+        for (int nInit : {1, 8})
+        {
+            options.nInit = nInit;
+            KMeansResult result = kmeans(mat, options);
+            bool reproducible = kmeans(mat, options).labels == result.labels;
+            std::cout << names[a] << " k=" << k << " nInit=" << nInit << ": " << result.iterations
+                      << " iterations, inertia " << result.inertia
+                      << (reproducible ? ", reproducible" : ", NOT reproducible") << std::endl;
+        }
+    }
+}
+
+// 不同线程数下的中心应逐位相同
+inline void testKMeansThreads(int row, int col, int k)
+{
+    std::mt19937 rng(19);
+    std::normal_distribution<float> normal(0, 1);
+    Eigen::MatrixXf mat(row, col);
+    for (int i = 0; i < row; i++)
+    {
+        for (int j = 0; j < col; j++)
+        {
+            mat(i, j) = normal(rng) + (i % k) * 2 * (j % 2 ? 1 : -1);
+        }
+    }
+
+    KMeansOptions options;
+    options.k = k;
+    for (KMeansAlgorithm algorithm : {KMeansAlgorithm::lloyd, KMeansAlgorithm::hamerly, KMeansAlgorithm::elkan})
+    {
+        options.algorithm = algorithm;
+        options.threads = 1;
+        KMeansResult serial = kmeans(mat, options);
+        bool identical = true;
+        for (size_t threads : {2, 3, 8})
+        {
+            options.threads = threads;
+            KMeansResult parallel = kmeans(mat, options);
+            identical = identical && parallel.labels == serial.labels && parallel.centers == serial.centers
+                        && parallel.inertia == serial.inertia;
+        }
+        std::cout << "algorithm " << int(algorithm) << " k=" << k << ": "
+                  << (identical ? "identical" : "DIFFERENT") << " for 1, 2, 3 and 8 threads" << std::endl;
+    }
+
+    // k-means||分块抽样，初始中心也应与线程数无关
+    options.algorithm = KMeansAlgorithm::automatic;
+    options.init = KMeansInit::parallel;
+    options.threads = 1;
+    KMeansResult serial = kmeans(mat, options);
+    options.threads = 4;
+    KMeansResult parallel = kmeans(mat, options);
+    std::cout << "k-means|| k=" << k << ": "
+              << (parallel.centers == serial.centers ? "identical" : "DIFFERENT") << " for 1 and 4 threads" << std::endl;
+}
+
+// 在较多样本上比较mini-batch与完整迭代的耗时和惯性
+inline void testKMeansMiniBatch(int row, int col, int k)
+{
+    std::mt19937 rng(17);
+    std::normal_distribution<float> normal(0, 1);
+    Eigen::MatrixXf mat(row, col);
+    for (int i = 0; i < row; i++)
+    {
+        for (int j = 0; j < col; j++)
+        {
+            mat(i, j) = normal(rng) + (i % k) * 4 * (j % 3 ? 1 : -1);
+        }
+    }
+
+    KMeansOptions options;
+    options.k = k;
+    options.nInit = 3;
+    auto start = std::chrono::steady_clock::now();
+    KMeansResult full = kmeans(mat, options);
+    auto middle = std::chrono::steady_clock::now();
+    KMeansResult mini = kmeansMiniBatch(mat, options);
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "full k=" << k << ": " << std::chrono::duration<double>(middle - start).count() << "s, "
+              << full.iterations << " iterations, inertia " << full.inertia << std::endl;
+    std::cout << "mini-batch k=" << k << ": " << std::chrono::duration<double>(end - middle).count() << "s, "
+              << mini.iterations << " steps, inertia " << mini.inertia << std::endl;
+}
+
+inline void testCluster()
 {
     std::vector<std::vector<float>> points = {
         {1, 2},
@@ -124,6 +1356,12 @@ void testCluster()
         std::cout << label << " ";
     }
     std::cout << std::endl;
+
+    testKMeansAlgorithms(5000, 8, 5);
+    testKMeansAlgorithms(5000, 8, 40);
+    testKMeansInit(20000, 6, 12);
+    testKMeansThreads(50000, 6, 9);
+    testKMeansMiniBatch(500000, 10, 8);
 }
 
 #endif // KMENAS_HPP
@@ -0,0 +1,242 @@
+#ifndef MOMENTS_HPP
+#define MOMENTS_HPP
+
+#include "common.h"
+#include "parallel.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+
+// 每个并行任务处理的元素数。任务的划分与线程数无关，按顺序合并，结果对任意线程数都相同
+const size_t momentsChunkSize = 1 << 16;
+// 任务内每次处理的元素数：在块内用两遍法求精确的中心矩（可向量化的归约），再合并到任务的结果中
+const size_t momentsBlockSize = 4096;
+
+// 一组数值的个数、均值、2~4阶中心矩之和与最值。add为Welford的逐个更新，
+// merge为Chan（及Pébay的高阶推广）的合并公式，两组分别统计后合并与一起统计的结果相同。
+// NaN视为缺失，不计入
+struct Moments
+{
+    long long count = 0;
+    double mean = 0;
+    // 各阶中心矩之和：sum((x - mean)^p)
+    double m2 = 0;
+    double m3 = 0;
+    double m4 = 0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+
+    void add(double x)
+    {
+        if (std::isnan(x))
+        {
+            return;
+        }
+        const double n1 = count;
+        count++;
+        const double n = count;
+        const double delta = x - mean;
+        const double deltaN = delta / n;
+        const double deltaN2 = deltaN * deltaN;
+        const double term = delta * deltaN * n1;
+        mean += deltaN;
+        m4 += term * deltaN2 * (n * n - 3 * n + 3) + 6 * deltaN2 * m2 - 4 * deltaN * m3;
+        m3 += term * deltaN * (n - 2) - 3 * deltaN * m2;
+        m2 += term;
+        min = std::min(min, x);
+        max = std::max(max, x);
+    }
+
+    void merge(const Moments &other)
+    {
+        if (other.count == 0)
+        {
+            return;
+        }
+        if (count == 0)
+        {
+            *this = other;
+            return;
+        }
+        const double na = count;
+        const double nb = other.count;
+        const double n = na + nb;
+        const double delta = other.mean - mean;
+        const double delta2 = delta * delta;
+        m4 += other.m4 + delta2 * delta2 * na * nb * (na * na - na * nb + nb * nb) / (n * n * n)
+              + 6 * delta2 * (na * na * other.m2 + nb * nb * m2) / (n * n)
+              + 4 * delta * (na * other.m3 - nb * m3) / n;
+        m3 += other.m3 + delta2 * delta * na * nb * (na - nb) / (n * n) + 3 * delta * (na * other.m2 - nb * m2) / n;
+        m2 += other.m2 + delta2 * na * nb / n;
+        mean += delta * nb / n;
+        count += other.count;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+
+    // 样本方差，除以n - 1
+    double variance() const { return m2 / double(std::max<long long>(1, count - 1)); }
+    double stddev() const { return std::sqrt(variance()); }
+    // 偏度和超额峰度，按总体矩计算；方差为0时为0
+    double skewness() const { return m2 > 0 ? std::sqrt(double(count)) * m3 / std::pow(m2, 1.5) : 0; }
+    double kurtosis() const { return m2 > 0 ? double(count) * m4 / (m2 * m2) - 3 : 0; }
+};
+
+// 统计一个块：先去掉NaN，再用两遍法求块内的中心矩
+inline Moments momentsOfBlock(const float *data, size_t n, Eigen::ArrayXd &buffer)
+{
+    Eigen::Index cnt = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (!std::isnan(data[i]))
+        {
+            buffer[cnt++] = data[i];
+        }
+    }
+
+    Moments block;
+    if (cnt == 0)
+    {
+        return block;
+    }
+    auto values = buffer.head(cnt);
+    block.count = cnt;
+    block.mean = values.sum() / cnt;
+    block.min = values.minCoeff();
+    block.max = values.maxCoeff();
+    values -= block.mean;
+    block.m2 = values.square().sum();
+    block.m3 = (values.square() * values).sum();
+    block.m4 = values.square().square().sum();
+    return block;
+}
+
+// 统计[data, data + n)。threads为0时使用全部硬件线程
+inline Moments momentsOf(const float *data, size_t n, size_t threads = 0)
+{
+    const size_t cntChunks = (n + momentsChunkSize - 1) / momentsChunkSize;
+    std::vector<Moments> chunks(cntChunks);
+    parallelFor(cntChunks, threads, [&](size_t chunk)
+    {
+        Eigen::ArrayXd buffer(momentsBlockSize);
+        const size_t end = std::min(n, (chunk + 1) * momentsChunkSize);
+        for (size_t begin = chunk * momentsChunkSize; begin < end; begin += momentsBlockSize)
+        {
+            chunks[chunk].merge(momentsOfBlock(data + begin, std::min(momentsBlockSize, end - begin), buffer));
+        }
+    });
+
+    Moments result;
+    for (const Moments &chunk : chunks)
+    {
+        result.merge(chunk);
+    }
+    return result;
+}
+
+inline Moments momentsOf(const std::vector<float> &x, size_t threads = 0)
+{
+    return momentsOf(x.data(), x.size(), threads);
+}
+
+// 矩阵每列的统计量。各列的各段作为独立的任务，列数少、行数多时也能用满线程
+inline std::vector<Moments> columnMoments(const Eigen::Ref<const Eigen::MatrixXf> &mat, size_t threads = 0)
+{
+    const size_t rows = mat.rows();
+    const size_t cols = mat.cols();
+    const size_t chunksPerCol = std::max<size_t>(1, (rows + momentsChunkSize - 1) / momentsChunkSize);
+    std::vector<Moments> chunks(cols * chunksPerCol);
+    parallelFor(chunks.size(), threads, [&](size_t task)
+    {
+        const size_t col = task / chunksPerCol;
+        const size_t chunk = task % chunksPerCol;
+        const float *data = mat.col(col).data();
+        Eigen::ArrayXd buffer(momentsBlockSize);
+        const size_t end = std::min(rows, (chunk + 1) * momentsChunkSize);
+        for (size_t begin = chunk * momentsChunkSize; begin < end; begin += momentsBlockSize)
+        {
+            chunks[task].merge(momentsOfBlock(data + begin, std::min(momentsBlockSize, end - begin), buffer));
+        }
+    });
+
+    std::vector<Moments> result(cols);
+    for (size_t col = 0; col < cols; col++)
+    {
+        for (size_t chunk = 0; chunk < chunksPerCol; chunk++)
+        {
+            result[col].merge(chunks[col * chunksPerCol + chunk]);
+        }
+    }
+    return result;
+}
+
+// 与逐个add、以及double下的两遍法比较。数据的均值远大于标准差，float下的单遍公式在这种情况下误差很大
+inline void testMoments()
+{
+    const size_t n = 1000003;
+    std::mt19937 rng(37);
+    std::gamma_distribution<float> gamma(2, 1);
+    std::vector<float> x(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        x[i] = 10000 + gamma(rng);
+    }
+    x[17] = std::numeric_limits<float>::quiet_NaN();
+
+    double sum = 0;
+    long long cnt = 0;
+    for (float v : x)
+    {
+        if (!std::isnan(v))
+        {
+            sum += v;
+            cnt++;
+        }
+    }
+    const double mean = sum / cnt;
+    double s2 = 0, s3 = 0, s4 = 0;
+    for (float v : x)
+    {
+        if (!std::isnan(v))
+        {
+            double d = v - mean;
+            s2 += d * d;
+            s3 += d * d * d;
+            s4 += d * d * d * d;
+        }
+    }
+
+    Moments sequential;
+    for (float v : x)
+    {
+        sequential.add(v);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Moments blocked = momentsOf(x);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    Moments threaded = momentsOf(x, 3);
+
+    std::cout << "moments two-pass: count " << cnt << ", mean " << mean << ", var " << s2 / (cnt - 1)
+              << ", skew " << std::sqrt(double(cnt)) * s3 / std::pow(s2, 1.5) << ", kurt " << cnt * s4 / (s2 * s2) - 3 << std::endl;
+    for (const Moments *m : {&sequential, &blocked, &threaded})
+    {
+        std::cout << "moments: count " << m->count << ", mean " << m->mean << ", var " << m->variance()
+                  << ", skew " << m->skewness() << ", kurt " << m->kurtosis()
+                  << ", min " << m->min << ", max " << m->max << std::endl;
+    }
+    std::cout << "blocked " << seconds << "s, threads agree " << (blocked.m2 == threaded.m2 && blocked.m4 == threaded.m4) << std::endl;
+
+    Eigen::MatrixXf mat = Eigen::Map<Eigen::MatrixXf>(x.data(), 1000, 1000);
+    auto cols = columnMoments(mat);
+    Moments merged;
+    for (const Moments &m : cols)
+    {
+        merged.merge(m);
+    }
+    std::cout << "columns merged: mean " << merged.mean << ", var " << merged.variance() << std::endl;
+}
+
+#endif // MOMENTS_HPP
@@ -0,0 +1,99 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// 可用的硬件线程数
+inline size_t hardwareThreads()
+{
+    unsigned int cnt = std::thread::hardware_concurrency();
+    return cnt == 0 ? 1 : cnt;
+}
+
+// 将线程数参数规范化：0表示使用全部硬件线程，且不超过任务数
+inline size_t resolveThreads(size_t threads, size_t cntTasks)
+{
+    if (threads == 0)
+    {
+        threads = hardwareThreads();
+    }
+    return std::max<size_t>(1, std::min(threads, cntTasks));
+}
+
+// 用threads个线程执行f(task)，task取遍[0, cntTasks)。任务按原子计数器动态领取，
+// 因此各任务的结果应写入按task索引的位置，不依赖执行顺序。
+// 任一任务抛出的第一个异常会在所有线程结束后重新抛出。
+template <typename F>
+void parallelFor(size_t cntTasks, size_t threads, F &&f)
+{
+    threads = resolveThreads(threads, cntTasks);
+    if (threads <= 1)
+    {
+        for (size_t task = 0; task < cntTasks; task++)
+        {
+            f(task);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next{0};
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    auto worker = [&]()
+    {
+        for (size_t task = next++; task < cntTasks; task = next++)
+        {
+            try
+            {
+                f(task);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error)
+                {
+                    error = std::current_exception();
+                }
+                next = cntTasks;
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (size_t i = 0; i + 1 < threads; i++)
+    {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : pool)
+    {
+        thread.join();
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+// 进度回调要求取消时，算法抛出该异常。在parallelFor的任务中抛出时，
+// 尚未开始的任务不再执行
+class TaskCancelled : public std::runtime_error
+{
+public:
+    TaskCancelled() : std::runtime_error("cancelled") {}
+};
+
+// 将[0, n)等分为cntBlocks块，返回第block块的起止位置
+inline std::pair<size_t, size_t> blockRange(size_t n, size_t cntBlocks, size_t block)
+{
+    return { n * block / cntBlocks, n * (block + 1) / cntBlocks };
+}
+
+#endif // PARALLEL_HPP
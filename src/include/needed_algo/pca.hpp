@@ -3,47 +3,300 @@
 
 #include "common.h"
 
-Eigen::MatrixXf pca(const std::vector<std::vector<float>> &in, const int k)
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+// 求前k个主成分的方法
+enum class PcaMethod
+{
+    // 构造d*d的协方差矩阵并完整地特征分解，d较小时最快
+    full,
+    // 随机化SVD（Halko, Martinsson, Tropp）：用随机矩阵乘以数据得到近似的列空间，
+    // 经几次幂迭代后在这个k + pcaOversampling维的子空间中做小规模SVD。全部运算为矩阵乘法
+    randomized,
+    // Lanczos迭代：只需协方差矩阵与向量的乘积，逐步构造Krylov子空间，取三对角矩阵的最大特征对
+    lanczos,
+    automatic
+};
+
+// d不超过该值，或k超过d的该比例时，automatic选择full
+const int pcaFullMaxDim = 64;
+const double pcaFullMinRatio = 0.25;
+// 数据的元素数超过该值时automatic选择randomized，矩阵乘法比逐个矩阵向量乘积更能利用缓存；否则选择lanczos
+const long long pcaRandomizedMinSize = 1LL << 25;
+// 随机化SVD多取的维数和幂迭代次数
+const int pcaOversampling = 10;
+const int pcaPowerIterations = 4;
+// Lanczos的步数为k的倍数加上一个常数，且不超过d
+const int pcaLanczosStepFactor = 2;
+const int pcaLanczosExtraSteps = 24;
+
+// 主成分分析的结果
+struct PcaResult
+{
+    // 各变量的均值
+    Eigen::RowVectorXf mean;
+    // 每列为一个主成分，按方差从大到小排列
+    Eigen::MatrixXf components;
+    // 各主成分上的方差（协方差矩阵的特征值，除以n - 1）
+    Eigen::VectorXf variances;
+    // 样本在各主成分上的投影，每行为一个样本
+    Eigen::MatrixXf scores;
+    PcaMethod method = PcaMethod::full;
+};
+
+// 列正交化，返回与a的列张成相同空间的标准正交列
+inline Eigen::MatrixXf pcaOrthonormalize(const Eigen::MatrixXf &a)
 {
-    if (in.empty())
+    Eigen::HouseholderQR<Eigen::MatrixXf> qr(a);
+    return qr.householderQ() * Eigen::MatrixXf::Identity(a.rows(), a.cols());
+}
+
+// 固定每个主成分的符号，使绝对值最大的分量为正，各方法和多次运行的结果方向一致
+inline void pcaFixSigns(Eigen::MatrixXf &components)
+{
+    for (int j = 0; j < components.cols(); j++)
     {
-        throw std::invalid_argument("in.empty()");
+        Eigen::Index idx;
+        components.col(j).cwiseAbs().maxCoeff(&idx);
+        if (components(idx, j) < 0)
+        {
+            components.col(j) *= -1;
+        }
     }
+}
 
-    if (k <= 0)
+inline PcaMethod pcaChooseMethod(long long n, int d, int k)
+{
+    if (d <= pcaFullMaxDim || k > pcaFullMinRatio * d)
     {
-        throw std::invalid_argument("k <= 0");
+        return PcaMethod::full;
+    }
+    return n * d > pcaRandomizedMinSize ? PcaMethod::randomized : PcaMethod::lanczos;
+}
+
+// centered为已中心化的样本，返回前k个主成分及其方差
+inline void pcaFull(const Eigen::MatrixXf &centered, int k, PcaResult &result)
+{
+    const int d = centered.cols();
+    Eigen::MatrixXf cov = centered.adjoint() * centered;
+    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXf> eig(cov);
+    // 特征值按升序排列，取最后k个并反转
+    result.components = eig.eigenvectors().rightCols(k).rowwise().reverse();
+    result.variances = eig.eigenvalues().tail(k).reverse();
+    (void)d;
+}
+
+inline void pcaRandomized(const Eigen::MatrixXf &centered, int k, PcaResult &result)
+{
+    const int d = centered.cols();
+    const int l = std::min(d, k + pcaOversampling);
+
+    // 固定种子的高斯随机矩阵，同样的数据总得到同样的结果
+    std::mt19937 rng(0);
+    std::normal_distribution<float> normal(0, 1);
+    Eigen::MatrixXf omega(d, l);
+    for (int j = 0; j < l; j++)
+    {
+        for (int i = 0; i < d; i++)
+        {
+            omega(i, j) = normal(rng);
+        }
+    }
+
+    // 幂迭代使小奇异值衰减，每次乘法后重新正交化以免舍入误差淹没较小的方向
+    Eigen::MatrixXf q = pcaOrthonormalize(centered * omega);
+    for (int iter = 0; iter < pcaPowerIterations; iter++)
+    {
+        Eigen::MatrixXf z = pcaOrthonormalize(centered.adjoint() * q);
+        q = pcaOrthonormalize(centered * z);
     }
 
-    size_t row = in.size();
-    size_t col = in[0].size();
+    // 在子空间中做SVD：B = Q^T X，X的右奇异向量近似为B的右奇异向量
+    Eigen::MatrixXf b = q.adjoint() * centered;
+    Eigen::JacobiSVD<Eigen::MatrixXf> svd(b, Eigen::ComputeThinV);
+    result.components = svd.matrixV().leftCols(k);
+    result.variances = svd.singularValues().head(k).array().square();
+}
+
+inline void pcaLanczos(const Eigen::MatrixXf &centered, int k, PcaResult &result)
+{
+    const int d = centered.cols();
+    const int m = std::min(d, pcaLanczosStepFactor * k + pcaLanczosExtraSteps);
+
+    // 三对角矩阵的对角线alpha和次对角线beta，basis的各列为Lanczos向量
+    Eigen::MatrixXf basis(d, m);
+    Eigen::VectorXf alpha(m);
+    Eigen::VectorXf beta = Eigen::VectorXf::Zero(m);
 
-    Eigen::MatrixXf mat(row, col);
-    for (size_t i = 0; i < row; i++)
+    std::mt19937 rng(0);
+    std::normal_distribution<float> normal(0, 1);
+    Eigen::VectorXf v(d);
+    for (int i = 0; i < d; i++)
     {
-        if (in[i].size() != col)
+        v[i] = normal(rng);
+    }
+    v.normalize();
+
+    int steps = m;
+    for (int j = 0; j < m; j++)
+    {
+        basis.col(j) = v;
+        // 协方差矩阵乘以向量，不构造协方差矩阵
+        Eigen::VectorXf w = centered.adjoint() * (centered * v);
+        alpha[j] = v.dot(w);
+        // 完全重正交化，保证Lanczos向量在浮点运算下保持正交
+        for (int pass = 0; pass < 2; pass++)
         {
-            throw std::invalid_argument("in[i].size() != col");
+            w -= basis.leftCols(j + 1) * (basis.leftCols(j + 1).adjoint() * w);
         }
-        for (size_t j = 0; j < col; j++)
+        if (j + 1 == m)
         {
-            mat(i, j) = in[i][j];
+            break;
         }
+        beta[j] = w.norm();
+        // Krylov子空间已不变，已得到精确的特征对
+        if (!(beta[j] > 1e-6f * std::abs(alpha[0])))
+        {
+            steps = j + 1;
+            break;
+        }
+        v = w / beta[j];
     }
 
-    Eigen::VectorXf avg = mat.colwise().mean();
-    Eigen::MatrixXf centered = mat.rowwise() - avg.transpose();
+    Eigen::MatrixXf tridiagonal = Eigen::MatrixXf::Zero(steps, steps);
+    for (int j = 0; j < steps; j++)
+    {
+        tridiagonal(j, j) = alpha[j];
+        if (j + 1 < steps)
+        {
+            tridiagonal(j, j + 1) = tridiagonal(j + 1, j) = beta[j];
+        }
+    }
+    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXf> eig(tridiagonal);
+    const int cnt = std::min(k, steps);
+    result.components = basis.leftCols(steps) * eig.eigenvectors().rightCols(cnt).rowwise().reverse();
+    result.variances = eig.eigenvalues().tail(cnt).reverse();
+}
 
-    Eigen::MatrixXf cov = centered.adjoint() * centered;
-    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXf> eig(cov);
-    Eigen::MatrixXf eigenVectors = eig.eigenvectors();
+// 样本为mat的各行，求前k个主成分。k超过变量数时按变量数计算
+inline PcaResult pcaDecompose(const Eigen::Ref<const Eigen::MatrixXf> &mat, int k,
+                              PcaMethod method = PcaMethod::automatic)
+{
+    if (mat.rows() == 0)
+    {
+        throw std::invalid_argument("mat.rows() == 0");
+    }
+
+    if (k <= 0)
+    {
+        throw std::invalid_argument("k <= 0");
+    }
 
-    Eigen::MatrixXf result = centered * eigenVectors.rightCols(k);
+    const long long n = mat.rows();
+    const int d = mat.cols();
+    k = std::min(k, d);
 
+    PcaResult result;
+    result.mean = mat.colwise().mean();
+    Eigen::MatrixXf centered = mat.rowwise() - result.mean;
+
+    if (method == PcaMethod::automatic)
+    {
+        method = pcaChooseMethod(n, d, k);
+    }
+    result.method = method;
+    switch (method)
+    {
+    case PcaMethod::randomized:
+        pcaRandomized(centered, k, result);
+        break;
+    case PcaMethod::lanczos:
+        pcaLanczos(centered, k, result);
+        break;
+    default:
+        pcaFull(centered, k, result);
+        break;
+    }
+
+    pcaFixSigns(result.components);
+    result.variances /= std::max<long long>(1, n - 1);
+    result.scores = centered * result.components;
     return result;
 }
 
-void testPCA()
+// 样本为mat的各行，返回样本在前k个主成分上的投影，第一列对应方差最大的主成分
+inline Eigen::MatrixXf pca(const Eigen::Ref<const Eigen::MatrixXf> &mat, const int k)
+{
+    return pcaDecompose(mat, k).scores;
+}
+
+inline Eigen::MatrixXf pca(const std::vector<std::vector<float>> &in, const int k)
+{
+    return pca(toMatrix(in), k);
+}
+
+// 测试用的n×d矩阵：8个方差依次减小的隐变量经随机载荷映射到d维，再加噪声和偏移5。
+// 前几个方向的方差明显较大，其余为噪声
+inline Eigen::MatrixXf pcaTestMatrix(int n, int d, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> normal(0, 1);
+    Eigen::MatrixXf latent(n, 8);
+    for (int i = 0; i < n; i++)
+    {
+        for (int j = 0; j < 8; j++)
+        {
+            latent(i, j) = normal(rng) * (8 - j);
+        }
+    }
+    Eigen::MatrixXf loading(8, d);
+    for (int i = 0; i < 8; i++)
+    {
+        for (int j = 0; j < d; j++)
+        {
+            loading(i, j) = normal(rng);
+        }
+    }
+    Eigen::MatrixXf mat = latent * loading;
+    for (int i = 0; i < n; i++)
+    {
+        for (int j = 0; j < d; j++)
+        {
+            mat(i, j) += normal(rng) + 5;
+        }
+    }
+    return mat;
+}
+
+// 以full的结果为准，比较randomized和lanczos的方差相对误差、主成分夹角的余弦和耗时
+inline void testPcaMethods(int n, int d, int k)
+{
+    Eigen::MatrixXf mat = pcaTestMatrix(n, d, 23);
+
+    const PcaMethod methods[3] = {PcaMethod::full, PcaMethod::randomized, PcaMethod::lanczos};
+    const char *names[3] = {"full", "randomized", "lanczos"};
+    PcaResult reference;
+    for (int a = 0; a < 3; a++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        PcaResult result = pcaDecompose(mat, k, methods[a]);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (a == 0)
+        {
+            reference = result;
+        }
+        float varianceError = ((result.variances - reference.variances).cwiseQuotient(reference.variances)).cwiseAbs().maxCoeff();
+        float minCosine = (result.components.adjoint() * reference.components).diagonal().minCoeff();
+        std::cout << names[a] << " n=" << n << " d=" << d << " k=" << k << ": " << seconds << "s"
+                  << ", variance error " << varianceError << ", min cosine " << minCosine << std::endl;
+    }
+    std::cout << "automatic chooses " << int(pcaChooseMethod(n, d, k)) << std::endl;
+}
+
+inline void testPCA()
 {
     std::vector<std::vector<float>> highDimPoints = {
         {2.5f, 1.2f, 0.01f},
@@ -77,6 +330,9 @@ void testPCA()
     };
     auto res = pca(highDimPoints, 2);
     std::cout << "res: \n" << res << std::endl;
+
+    testPcaMethods(2000, 300, 3);
+    testPcaMethods(20000, 400, 3);
 }
 
 #endif // PCA_HPP
@@ -2,22 +2,21 @@
 #define ROWFEATURE_HPP
 
 #include "common.h"
+#include "moments.hpp"
 
-std::tuple<float, float> getAvgVar(const std::vector<float> &inX)
+// 均值和样本方差（除以n - 1），与moments.hpp的其他使用者一致
+inline std::tuple<float, float> getAvgVar(const std::vector<float> &inX)
 {
     if (inX.empty())
     {
         throw std::invalid_argument("inX.empty()");
     }
 
-    Eigen::Map<const Eigen::VectorXf> x(inX.data(), inX.size());
-    float avg = x.mean();
-    auto diff = x.array() - avg;
-    float var = diff.square().sum() / (inX.size() - 1);
-    return { avg, var };
+    Moments moments = momentsOf(inX);
+    return { float(moments.mean), float(moments.variance()) };
 }
 
-void testAvgVar()
+inline void testAvgVar()
 {
     std::vector<float> x = {1, 2, 3, 4, 5};
     auto avgVar = getAvgVar(x);
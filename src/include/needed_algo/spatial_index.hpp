@@ -0,0 +1,387 @@
+#ifndef SPATIAL_INDEX_HPP
+#define SPATIAL_INDEX_HPP
+
+#include "common.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+
+// 维数不超过该值时使用均匀网格，否则使用KD树
+const int gridMaxDim = 3;
+// 网格每一维的格数上限，超过时改用KD树
+const int64_t gridMaxCells = int64_t(1) << 20;
+// KD树叶节点的最大点数
+const int kdLeafSize = 16;
+
+// 固定半径epsilon的近邻查询索引。低维时使用边长为epsilon的均匀网格，
+// 查询只需检查相邻的3^d个格子；高维时使用按最宽维度中位数切分的KD树。
+// 点的坐标按格子或叶节点的顺序重新排列，同一格子中的点在内存中连续。
+class SpatialIndex
+{
+public:
+    SpatialIndex(const Eigen::Ref<const Eigen::MatrixXf> &points, float epsilon);
+
+    int size() const { return n; }
+    int dim() const { return d; }
+    float radius() const { return epsilon; }
+    bool usesGrid() const { return useGrid; }
+
+    // 对与第idx个点距离不超过epsilon的每个点（包括自身）调用f(j)
+    template <typename F>
+    void forEachNeighbor(int idx, F &&f) const;
+
+    // 将与第idx个点距离不超过epsilon的点（包括自身）写入out
+    void radiusNeighbors(int idx, std::vector<int> &out) const
+    {
+        out.clear();
+        forEachNeighbor(idx, [&](int j) { out.push_back(j); });
+    }
+
+    int countNeighbors(int idx) const
+    {
+        int cnt = 0;
+        forEachNeighbor(idx, [&](int) { cnt++; });
+        return cnt;
+    }
+
+private:
+    struct KdNode
+    {
+        int begin;
+        int end;
+        int left = -1;
+        int right = -1;
+        int dim = 0;
+        float split = 0;
+    };
+
+    int n = 0;
+    int d = 0;
+    float epsilon = 0;
+    float epsilon2 = 0;
+    bool useGrid = false;
+
+    // 原始顺序的坐标，按行存放
+    std::vector<float> coords;
+    // 重排后的点序号和对应的坐标
+    std::vector<int> order;
+    std::vector<float> sorted;
+
+    // 网格：各维的最小值，以及格子编号到order中区间的映射
+    std::vector<float> lower;
+    std::unordered_map<uint64_t, std::pair<int, int>> cells;
+
+    std::vector<KdNode> nodes;
+
+    const float *point(int idx) const { return &coords[size_t(idx) * d]; }
+
+    float distance2(const float *p, const float *q) const
+    {
+        float dist = 0;
+        for (int k = 0; k < d; k++)
+        {
+            float diff = p[k] - q[k];
+            dist += diff * diff;
+        }
+        return dist;
+    }
+
+    int64_t cellCoord(float x, int k) const { return int64_t(std::floor((x - lower[k]) / epsilon)); }
+
+    uint64_t cellKey(const int64_t *c) const
+    {
+        uint64_t key = 0;
+        for (int k = 0; k < d; k++)
+        {
+            key |= uint64_t(c[k]) << (21 * k);
+        }
+        return key;
+    }
+
+    bool buildGrid();
+    void buildKdTree();
+    int buildKdNode(int begin, int end);
+    void fillSorted();
+};
+
+inline SpatialIndex::SpatialIndex(const Eigen::Ref<const Eigen::MatrixXf> &points, float _epsilon)
+    : n(points.rows()), d(points.cols()), epsilon(_epsilon), epsilon2(_epsilon * _epsilon)
+{
+    if (!(epsilon > 0))
+    {
+        throw std::invalid_argument("epsilon <= 0");
+    }
+
+    coords.resize(size_t(n) * d);
+    for (int i = 0; i < n; i++)
+    {
+        for (int k = 0; k < d; k++)
+        {
+            coords[size_t(i) * d + k] = points(i, k);
+        }
+    }
+
+    order.resize(n);
+    for (int i = 0; i < n; i++)
+    {
+        order[i] = i;
+    }
+
+    useGrid = d <= gridMaxDim && buildGrid();
+    if (!useGrid)
+    {
+        buildKdTree();
+    }
+    fillSorted();
+}
+
+// 按格子编号排序各点。坐标范围相对epsilon过大时返回false，改用KD树
+inline bool SpatialIndex::buildGrid()
+{
+    lower.assign(d, 0);
+    std::vector<float> upper(d, 0);
+    for (int k = 0; k < d; k++)
+    {
+        if (n > 0)
+        {
+            lower[k] = upper[k] = coords[k];
+        }
+        for (int i = 0; i < n; i++)
+        {
+            const float x = coords[size_t(i) * d + k];
+            // NaN和无穷大没有格子，转换为整数是未定义行为
+            if (!std::isfinite(x))
+            {
+                return false;
+            }
+            lower[k] = std::min(lower[k], x);
+            upper[k] = std::max(upper[k], x);
+        }
+        // 先在浮点数上比较格数，epsilon很小或范围很大时商超出int64的范围，不能先转换再比较。
+        // 格号不超过gridMaxCells，cellKey每维21位足够
+        if (!((double(upper[k]) - lower[k]) / epsilon < double(gridMaxCells)))
+        {
+            return false;
+        }
+    }
+
+    std::vector<uint64_t> keys(n);
+    for (int i = 0; i < n; i++)
+    {
+        int64_t c[gridMaxDim];
+        for (int k = 0; k < d; k++)
+        {
+            c[k] = cellCoord(point(i)[k], k);
+        }
+        keys[i] = cellKey(c);
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return keys[a] < keys[b]; });
+
+    for (int begin = 0; begin < n;)
+    {
+        int end = begin + 1;
+        while (end < n && keys[order[end]] == keys[order[begin]])
+        {
+            end++;
+        }
+        cells.emplace(keys[order[begin]], std::make_pair(begin, end));
+        begin = end;
+    }
+    return true;
+}
+
+inline void SpatialIndex::buildKdTree()
+{
+    nodes.reserve(2 * (n / kdLeafSize + 1));
+    if (n > 0)
+    {
+        buildKdNode(0, n);
+    }
+}
+
+// 在最宽的维度上按中位数切分order[begin, end)，返回节点序号
+inline int SpatialIndex::buildKdNode(int begin, int end)
+{
+    int idx = nodes.size();
+    nodes.push_back(KdNode{begin, end});
+    if (end - begin <= kdLeafSize)
+    {
+        return idx;
+    }
+
+    int widest = 0;
+    float widestExtent = 0;
+    for (int k = 0; k < d; k++)
+    {
+        float lo = point(order[begin])[k];
+        float hi = lo;
+        for (int i = begin + 1; i < end; i++)
+        {
+            float x = point(order[i])[k];
+            lo = std::min(lo, x);
+            hi = std::max(hi, x);
+        }
+        if (hi - lo > widestExtent)
+        {
+            widestExtent = hi - lo;
+            widest = k;
+        }
+    }
+    // 所有点重合，无法再切分
+    if (!(widestExtent > 0))
+    {
+        return idx;
+    }
+
+    int mid = begin + (end - begin) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                     [&](int a, int b) { return point(a)[widest] < point(b)[widest]; });
+    nodes[idx].dim = widest;
+    nodes[idx].split = point(order[mid])[widest];
+
+    int left = buildKdNode(begin, mid);
+    int right = buildKdNode(mid, end);
+    nodes[idx].left = left;
+    nodes[idx].right = right;
+    return idx;
+}
+
+inline void SpatialIndex::fillSorted()
+{
+    sorted.resize(size_t(n) * d);
+    for (int i = 0; i < n; i++)
+    {
+        std::copy(point(order[i]), point(order[i]) + d, &sorted[size_t(i) * d]);
+    }
+}
+
+template <typename F>
+void SpatialIndex::forEachNeighbor(int idx, F &&f) const
+{
+    const float *q = point(idx);
+    auto scan = [&](int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            if (distance2(q, &sorted[size_t(i) * d]) <= epsilon2)
+            {
+                f(order[i]);
+            }
+        }
+    };
+
+    if (useGrid)
+    {
+        int64_t center[gridMaxDim];
+        for (int k = 0; k < d; k++)
+        {
+            center[k] = cellCoord(q[k], k);
+        }
+        // 依次枚举每一维偏移-1、0、1的组合
+        int cntOffsets = 1;
+        for (int k = 0; k < d; k++)
+        {
+            cntOffsets *= 3;
+        }
+        for (int offset = 0; offset < cntOffsets; offset++)
+        {
+            int64_t c[gridMaxDim];
+            bool inside = true;
+            for (int k = 0, rest = offset; k < d; k++, rest /= 3)
+            {
+                c[k] = center[k] + rest % 3 - 1;
+                inside = inside && c[k] >= 0 && c[k] < gridMaxCells;
+            }
+            if (!inside)
+            {
+                continue;
+            }
+            auto cell = cells.find(cellKey(c));
+            if (cell != cells.end())
+            {
+                scan(cell->second.first, cell->second.second);
+            }
+        }
+        return;
+    }
+
+    if (nodes.empty())
+    {
+        return;
+    }
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const KdNode &node = nodes[stack[--top]];
+        if (node.left < 0)
+        {
+            scan(node.begin, node.end);
+            continue;
+        }
+        float diff = q[node.dim] - node.split;
+        if (diff <= epsilon)
+        {
+            stack[top++] = node.left;
+        }
+        if (-diff <= epsilon)
+        {
+            stack[top++] = node.right;
+        }
+    }
+}
+
+// 与逐点线性扫描的结果比较，分别测试网格和KD树
+inline void testSpatialIndex()
+{
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> uniform(0, 10);
+    for (int dim : {2, 6})
+    {
+        const int n = 2000;
+        const float epsilon = dim == 2 ? 0.3f : 2.5f;
+        Eigen::MatrixXf points(n, dim);
+        for (int i = 0; i < n; i++)
+        {
+            for (int k = 0; k < dim; k++)
+            {
+                points(i, k) = uniform(rng);
+            }
+        }
+
+        SpatialIndex index(points, epsilon);
+        int cntMismatch = 0;
+        long long cntPairs = 0;
+        std::vector<int> neighbors;
+        for (int i = 0; i < n; i++)
+        {
+            index.radiusNeighbors(i, neighbors);
+            std::sort(neighbors.begin(), neighbors.end());
+            std::vector<int> expected;
+            for (int j = 0; j < n; j++)
+            {
+                if ((points.row(i) - points.row(j)).squaredNorm() <= epsilon * epsilon)
+                {
+                    expected.push_back(j);
+                }
+            }
+            cntPairs += expected.size();
+            cntMismatch += neighbors != expected;
+        }
+        std::cout << "dim " << dim << (index.usesGrid() ? " grid" : " kd-tree")
+                  << ": pairs " << cntPairs << ", mismatched points " << cntMismatch << std::endl;
+    }
+
+    // 范围相对epsilon超出int64时不能使用网格，应改用KD树
+    Eigen::MatrixXf wide(3, 2);
+    wide << 0, 0, 1e30f, 1, 1e-30f, 0;
+    SpatialIndex wideIndex(wide, 1e-20f);
+    std::cout << "wide range: " << (wideIndex.usesGrid() ? "grid" : "kd-tree")
+              << ", neighbors of first point " << wideIndex.countNeighbors(0) << std::endl;
+}
+
+#endif // SPATIAL_INDEX_HPP
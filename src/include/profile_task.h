@@ -0,0 +1,32 @@
+#ifndef PROFILE_TASK_H
+#define PROFILE_TASK_H
+
+#include "dataset.h"
+
+#include <QThread>
+
+/**
+ * @brief 在后台线程中统计数据表中尚未统计的数值列。运行期间数据表不能被修改；
+ * 结束后在界面线程用apply把结果写回数据表。
+ *
+ */
+class Profile_Task : public QThread
+{
+    Q_OBJECT
+public:
+    Profile_Task(const Dataset &dataset, QObject *parent = nullptr);
+
+    // 把统计结果写回数据表，只能在线程结束后调用
+    void apply(Dataset &target);
+
+protected:
+    void run() override;
+
+private:
+    const Dataset &dataset;
+    // 要统计的列，在构造时确定
+    const std::vector<size_t> cols;
+    std::vector<Column_Profile> profiles;
+};
+
+#endif // PROFILE_TASK_H
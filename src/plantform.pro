@@ -12,10 +12,20 @@ CONFIG += c++17
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    cache_writer.cpp \
+    cluster_task.cpp \
+    column_profile.cpp \
     common_utils.cpp \
+    csv_parser.cpp \
+    dataset.cpp \
+    dataset_cache.cpp \
+    dataset_loader.cpp \
+    dataset_model.cpp \
     main.cpp \
+    profile_task.cpp \
     widget.cpp \
     window_barchart.cpp \
+    window_boxplot.cpp \
     window_cluster.cpp \
     window_covariance.cpp \
     window_ml.cpp \
@@ -23,6 +33,7 @@ SOURCES += \
     window_scatter.cpp
 
 HEADERS += \
+    dataset_model.h \
     Eigen/Cholesky \
     Eigen/CholmodSupport \
     Eigen/Core \
@@ -360,7 +371,14 @@ HEADERS += \
     Eigen/src/plugins/MatrixCwiseBinaryOps.h \
     Eigen/src/plugins/MatrixCwiseUnaryOps.h \
     Eigen/src/plugins/ReshapedMethods.h \
+    include/cache_writer.h \
+    include/cluster_task.h \
+    include/column_profile.h \
     include/common_utils.h \
+    include/csv_parser.h \
+    include/dataset.h \
+    include/dataset_cache.h \
+    include/dataset_loader.h \
     include/needed_algo/Eigen/Cholesky \
     include/needed_algo/Eigen/CholmodSupport \
     include/needed_algo/Eigen/Core \
@@ -701,13 +719,22 @@ HEADERS += \
     include/needed_algo/common.h \
     include/needed_algo/covariance.hpp \
     include/needed_algo/dbscan.hpp \
+    include/needed_algo/histogram.hpp \
+    include/needed_algo/hyperloglog.hpp \
+    include/needed_algo/incremental_pca.hpp \
+    include/needed_algo/kll.hpp \
     include/needed_algo/kmeans.hpp \
     include/needed_algo/leastsquare.hpp \
+    include/needed_algo/moments.hpp \
+    include/needed_algo/parallel.hpp \
     include/needed_algo/pca.hpp \
     include/needed_algo/rowfeature.hpp \
+    include/needed_algo/spatial_index.hpp \
     include/needed_algo/xgboost_example.h \
+    include/profile_task.h \
     widget.h \
     window_barchart.h \
+    window_boxplot.h \
     window_cluster.h \
     window_covariance.h \
     window_ml.h \
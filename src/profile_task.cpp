@@ -0,0 +1,36 @@
+#include "include/profile_task.h"
+#include "include/needed_algo/parallel.hpp"
+
+/**
+ * @brief Construct a new Profile_Task::Profile_Task object
+ *
+ * @param _dataset 数据表，运行期间只读取，不能被修改。
+ * @param parent
+ */
+Profile_Task::Profile_Task(const Dataset &_dataset, QObject *parent):
+    QThread(parent), dataset(_dataset), cols(_dataset.unprofiled_columns()){
+}
+
+/**
+ * @brief 把统计结果写回数据表。
+ *
+ * @param target 构造时传入的数据表。
+ */
+void Profile_Task::apply(Dataset &target){
+    target.set_profiles(cols, std::move(profiles));
+    profiles.clear();
+}
+
+/**
+ * @brief 后台线程的入口。
+ *
+ */
+void Profile_Task::run(){
+    try{
+        profiles = dataset.compute_profiles(cols, 0, [this](){
+            return !isInterruptionRequested();
+        });
+    }
+    catch (const TaskCancelled &){
+    }
+}
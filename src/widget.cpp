@@ -1,13 +1,16 @@
 #include "widget.h"
 #include "ui_widget.h"
 #include "window_barchart.h"
+#include "window_boxplot.h"
 #include "window_scatter.h"
 #include "window_covariance.h"
 #include "window_pca.h"
 #include "window_cluster.h"
 #include "window_ml.h"
 #include "include/needed_algo/kmeans.hpp"
-#include "include/needed_algo/dbscan.hpp"
+#include "include/dataset_loader.h"
+#include "include/profile_task.h"
+#include "include/cache_writer.h"
 
 #include <QFile>
 #include <QTextStream>
@@ -22,8 +25,12 @@
 #include <QFileDialog>
 #include <QTableWidget>
 #include <QTableView>
+#include <QHeaderView>
 #include <QMessageBox>
 #include <QRandomGenerator>
+#include <QProgressDialog>
+
+#include <cmath>
 
 std::vector<QColor> colors_set{
    QColor(255, 0, 0),     // 红色
@@ -40,7 +47,8 @@ std::vector<QColor> colors_set{
 
 std::map<Cluster_method, QString> map_method_string{
     {Cluster_method::kmeans, "K-means_cluster"},
-    {Cluster_method::dbscan, "dbscan_cluster"}
+    {Cluster_method::dbscan, "dbscan_cluster"},
+    {Cluster_method::minibatch, "minibatch_cluster"}
 };
 
 Widget::Widget(QWidget *parent)
@@ -53,62 +61,226 @@ Widget::Widget(QWidget *parent)
 
 //    导入数据，显示表格
     ui->tableView->setModel(model);
+//    固定行高，避免视图为每一行计算高度
+    ui->tableView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
 
 //    打开文件
+    set_loading_visible(false);
     open_table();
 }
 
 Widget::~Widget()
 {
+    stop_loading();
+    stop_profiling();
+    stop_cache_writer();
+    stop_cluster_task();
     delete ui;
 }
 
 /**
- * @brief 根据path_table打开csv文件，将数据显示在表格中。
+ * @brief 根据path_table在后台打开csv文件，数据逐批显示在表格中。加载完成前分析按钮不可用。
  * 
  */
 void Widget::open_table(){
-    QFile file(path_table);
-    if (file.open(QIODevice::ReadOnly | QIODevice::Text)){
-        model->clear();
-
-        QTextStream in(&file);
-
-        QString headerLine = in.readLine();
-        QStringList headerFields = headerLine.split(",");
-        model->setHorizontalHeaderLabels(headerFields);
-        for (int64_t i = 0; i < headerFields.size(); i ++) {
-            if (headerFields[i] == "diagnosis") {
-                col_diagnosis_at = i;
-            }
-        }
+    stop_loading();
+    stop_profiling();
+    stop_cache_writer();
+    stop_cluster_task();
+    model->set_dataset(Dataset());
+    set_analysis_enabled(false);
+    ui->progress_loading->setValue(0);
+    ui->label_loading->clear();
+    set_loading_visible(true);
+
+    loader = new Dataset_Loader(path_table, this);
+    connect(loader, &Dataset_Loader::segments_ready, this, &Widget::append_loaded_rows);
+    connect(loader, &Dataset_Loader::progress, this, &Widget::show_loading_progress);
+    connect(loader, &QThread::finished, this, &Widget::finish_loading);
+    loader->start();
+}
+
+/**
+ * @brief 取消正在进行的加载并等待后台线程结束。
+ *
+ */
+void Widget::stop_loading(){
+    if (!loader){
+        return;
+    }
+    loader->requestInterruption();
+    loader->wait();
+//    已发出的信号仍在事件队列中，延迟删除以免其发送者失效
+    loader->deleteLater();
+    loader = nullptr;
+}
 
-        int row = 0;
-        while (!in.atEnd()) {
-            QString line = in.readLine();
-            QStringList fields = line.split(",");
-
-            for (int col = 0; col < fields.size(); col++){
-                QString& val = fields[col];
-//                benign 良性 0
-//                malignant 恶性 1
-                if (val == "B"){
-                    val = "0";
-                }
-                else if (val == "M"){
-                    val = "1";
-                }
-                QStandardItem *item = new QStandardItem(fields[col]);
-                model->setItem(row, col, item);
-            }
-
-            row++;
+/**
+ * @brief 将后台线程已解析的各批数据追加到表格末尾。
+ *
+ */
+void Widget::append_loaded_rows(){
+    if (!loader || sender() != loader){
+        return;
+    }
+    for (Dataset &segment : loader->take_segments()){
+//        列与表格不一致时停止加载
+        if (!model->append_rows(std::move(segment))){
+            loader->requestInterruption();
+            return;
         }
+    }
+}
 
-        file.close();
+/**
+ * @brief 显示加载进度、行速率和字节速率。
+ *
+ */
+void Widget::show_loading_progress(qint64 bytes_done, qint64 bytes_total, qint64 rows, double seconds){
+    if (!loader || sender() != loader){
+        return;
     }
-    else{
-        qDebug() << "fail to open";
+    const double mb = 1024.0 * 1024.0;
+    ui->progress_loading->setValue(bytes_total > 0 ? bytes_done * 1000 / bytes_total : 1000);
+    ui->label_loading->setText(QString("%1 / %2 MB，%3 行，%4 行/秒，%5 MB/秒")
+                                   .arg(bytes_done / mb, 0, 'f', 1)
+                                   .arg(bytes_total / mb, 0, 'f', 1)
+                                   .arg(rows)
+                                   .arg(seconds > 0 ? rows / seconds : 0, 0, 'f', 0)
+                                   .arg(seconds > 0 ? bytes_done / mb / seconds : 0, 0, 'f', 1));
+}
+
+/**
+ * @brief 后台线程结束后恢复界面。完整读取csv文件时在后台写入缓存；取消时保留已加载的行。
+ *
+ */
+void Widget::finish_loading(){
+    if (!loader || sender() != loader){
+        return;
+    }
+    append_loaded_rows();
+    if (loader->can_cache()){
+        cache_writer = new Cache_Writer(dataset, path_table, loader->source_key(), this);
+        connect(cache_writer, &QThread::finished, this, &Widget::finish_cache_writer);
+        cache_writer->start();
+    }
+    loader->deleteLater();
+    loader = nullptr;
+
+    set_loading_visible(false);
+    update_col_diagnosis();
+//    在后台统计各列，完成后再启用分析按钮，之后的方差、直方图窗口直接使用统计结果
+    start_profiling();
+}
+
+/**
+ * @brief 在后台统计尚未统计的数值列，完成前分析按钮不可用。
+ * 统计期间数据表不能被修改，修改前先调用stop_profiling。
+ *
+ */
+void Widget::start_profiling(){
+    stop_profiling();
+    set_analysis_enabled(false);
+    profile_task = new Profile_Task(dataset, this);
+    connect(profile_task, &QThread::finished, this, &Widget::finish_profiling);
+    profile_task->start();
+}
+
+/**
+ * @brief 取消正在进行的统计并等待其结束，不写回其结果。未写回的列仍为未统计，下次start_profiling时重新统计。
+ *
+ */
+void Widget::stop_profiling(){
+    if (!profile_task){
+        return;
+    }
+    profile_task->requestInterruption();
+    profile_task->wait();
+    profile_task->deleteLater();
+    profile_task = nullptr;
+}
+
+/**
+ * @brief 统计结束后写回结果并启用分析按钮。
+ *
+ */
+void Widget::finish_profiling(){
+    if (!profile_task || sender() != profile_task){
+        return;
+    }
+    profile_task->apply(dataset);
+    profile_task->deleteLater();
+    profile_task = nullptr;
+    set_analysis_enabled(true);
+}
+
+/**
+ * @brief 放弃正在写的缓存并等待写缓存的线程结束，替换数据表前调用。
+ *
+ */
+void Widget::stop_cache_writer(){
+    if (!cache_writer){
+        return;
+    }
+    cache_writer->requestInterruption();
+    cache_writer->wait();
+    cache_writer->deleteLater();
+    cache_writer = nullptr;
+}
+
+/**
+ * @brief 缓存写完后释放线程。
+ *
+ */
+void Widget::finish_cache_writer(){
+    if (!cache_writer || sender() != cache_writer){
+        return;
+    }
+    cache_writer->deleteLater();
+    cache_writer = nullptr;
+}
+
+/**
+ * @brief 取消加载按钮的槽函数。
+ *
+ */
+void Widget::on_button_cancel_clicked()
+{
+    if (loader){
+        loader->requestInterruption();
+    }
+}
+
+/**
+ * @brief 启用或禁用依赖完整数据的分析按钮。
+ *
+ */
+void Widget::set_analysis_enabled(bool enabled){
+    for (QPushButton *button : {ui->button_variance, ui->button_barchart, ui->button_boxplot, ui->button_scatter,
+                                ui->button_covariance, ui->button_pca, ui->button_cluster,
+                                ui->button_coloring, ui->button_ml}){
+        button->setEnabled(enabled);
+    }
+}
+
+/**
+ * @brief 显示或隐藏加载进度条和取消按钮。
+ *
+ */
+void Widget::set_loading_visible(bool visible){
+    ui->progress_loading->setVisible(visible);
+    ui->label_loading->setVisible(visible);
+    ui->button_cancel->setVisible(visible);
+}
+
+/**
+ * @brief 根据列名更新诊断结果所在的列。
+ *
+ */
+void Widget::update_col_diagnosis(){
+    int col_diagnosis = dataset.index_of("diagnosis");
+    if (col_diagnosis >= 0){
+        col_diagnosis_at = col_diagnosis;
     }
 }
 
@@ -126,36 +298,42 @@ void Widget::delete_obj(QObject *obj){
  * @brief 获取选中的列的数据。不允许选中id列，否则会弹出错误提示框。
  * 
  * @param least_cols 最少需要选中的列数。
- * @return std::vector<std::vector<float>> 
+ * @return Dataset_View 样本为行、选中的列为列的矩阵。出错时为空。
  */
-std::vector<std::vector<float>> Widget::samples_selected(size_t least_cols){
+Dataset_View Widget::samples_selected(size_t least_cols){
     // 获取选中的列
     QModelIndexList selectedColumns = ui->tableView->selectionModel()->selectedColumns();
 
     const size_t cnt_cols = selectedColumns.size();
-    const size_t cnt_rows = model->rowCount();
 
     if (cnt_cols < least_cols){
         QMessageBox::critical(this, "Error", "Please select at least" + QString::number(least_cols) + "column.");
         return {};
     }
 
-    std::vector<std::vector<float>> samples;
-
-    for (size_t row = 0; row < cnt_rows; row ++){
-        std::vector<float> variants;
-        for (size_t j = 0; j < cnt_cols; j ++){
-            if (model->horizontalHeaderItem(selectedColumns[j].column())->text() == "id"){
-                QMessageBox::critical(this, "Error", "Please do not select id column.");
-                return {};
-            }
-            QModelIndex index = model->index(row, selectedColumns[j].column());
-            variants.push_back(model->data(index).toFloat());
+    std::vector<size_t> cols(cnt_cols);
+    for (size_t j = 0; j < cnt_cols; j ++){
+        cols[j] = selectedColumns[j].column();
+        if (dataset.name(cols[j]) == "id"){
+            QMessageBox::critical(this, "Error", "Please do not select id column.");
+            return {};
         }
-        samples.push_back(std::move(variants));
     }
 
-    return samples;
+    return dataset.select(cols);
+}
+
+/**
+ * @brief 数据表正在加载或统计时不能聚类：聚类只会用到部分数据，结果写回时还会给表格添加列。
+ *
+ * @return true 数据表已就绪。
+ */
+bool Widget::table_ready(){
+    if (loader || profile_task){
+        QMessageBox::critical(this, "Error", "The table is still loading.");
+        return false;
+    }
+    return true;
 }
 
 /**
@@ -165,32 +343,13 @@ std::vector<std::vector<float>> Widget::samples_selected(size_t least_cols){
  * @param labels 该聚类方法的分组
  */
 void Widget::add_cluster(Cluster_method method, std::vector<int> labels){
-    const size_t cnt_total_cols = model->columnCount();
-    size_t col_cluster = cnt_total_cols;
-    const size_t cnt_total_rows = model->rowCount();
-    //    寻找
-    bool exist_cluster = false;
-    for (int col = cnt_total_cols - 1; col >= 0; col --){
-        if (model->horizontalHeaderItem(col)->text() == map_method_string[method]){
-            exist_cluster = true;
-            col_cluster = col;
-            break;
-        }
-    }
-    //    找不到则创建
-    if (!exist_cluster){
-        col_cluster = cnt_total_cols;
-        auto newHeaderItem = new QStandardItem(map_method_string[method]);
-        model->setHorizontalHeaderItem(col_cluster, newHeaderItem);
-        for (size_t row = 0; row < cnt_total_rows; row ++){
-            auto item = new QStandardItem("");
-            model->setItem(row, col_cluster, item);
-        }
-    }
-
-    for (size_t row = 0; row < cnt_total_rows; row ++){
-        model->item(row, col_cluster)->setText(QString::number(labels[row]));
+    stop_profiling();
+//    缓存只含csv文件中的列，等它写完而不是放弃
+    if (cache_writer){
+        cache_writer->wait();
     }
+    model->set_int_column(map_method_string[method].toStdString(), labels);
+    start_profiling();
 }
 
 /**
@@ -199,17 +358,13 @@ void Widget::add_cluster(Cluster_method method, std::vector<int> labels){
  * @param method 聚类方法
  */
 void Widget::coloring_method(Cluster_method method){
-    auto label = get_labels_of(method);
+    auto labels = get_labels_of(method);
     int cnt_groups = map_cluster_groups[method];
     if (cnt_groups == 0){
         QMessageBox::critical(this, "Error", "Cluster data not found.");
         return;
     }
 
-    const size_t cnt_total_rows = model->rowCount();
-    const size_t cnt_total_cols = model->columnCount();
-    const int col_cluster = map_cluster_col[method];
-
     //    取颜色
     std::vector<QColor> colors;
     for (int i = 0; i < cnt_groups; i ++){
@@ -219,19 +374,8 @@ void Widget::coloring_method(Cluster_method method){
         colors.push_back(QColor(r, g, b));
     }
 
-    //    着色
-    for (size_t row = 0; row < cnt_total_rows; row ++){
-        auto index = model->index(row, col_cluster);
-        int label = model->data(index).toInt();
-        for (size_t col = 0; col < cnt_total_cols; col ++){
-            if (label == -1){
-                model->item(row, col)->setBackground(QBrush(Qt::white));
-            }
-            else {
-                model->item(row, col)->setBackground(QBrush(colors[label]));
-            }
-        }
-    }
+    //    着色，噪声点（-1）不着色
+    model->set_row_colors(labels, colors);
 }
 
 /**
@@ -241,18 +385,8 @@ void Widget::coloring_method(Cluster_method method){
  * @return std::vector<int> 
  */
 std::vector<int> Widget::get_labels_of(Cluster_method method){
-    const size_t cnt_total_rows = model->rowCount();
-    size_t cnt_total_cols = model->columnCount();
-    size_t col_cluster = cnt_total_cols;
-    bool exist_cluster = false;
-    for (int col = cnt_total_cols - 1; col >= 0; col --){
-        if (model->horizontalHeaderItem(col)->text() == map_method_string[method]){
-            col_cluster = col;
-            exist_cluster = true;
-            break;
-        }
-    }
-    if (!exist_cluster){
+    int col_cluster = dataset.index_of(map_method_string[method].toStdString());
+    if (col_cluster < 0){
         map_cluster_col[method] = -1;
         map_cluster_groups[method] = 0;
         return {};
@@ -261,13 +395,11 @@ std::vector<int> Widget::get_labels_of(Cluster_method method){
 
 //    获取每个样本的分组
 //    记录组的总数
+    std::vector<int> labels = dataset.int_column(col_cluster);
     int max_label = -1;
-    std::vector<int> labels;
-    for (size_t row = 0; row < cnt_total_rows; row ++){
-        auto index = model->index(row, col_cluster);
-        labels.push_back(model->data(index).toInt());
-        if (labels.back() > max_label){
-            max_label = labels.back();
+    for (int label : labels){
+        if (label > max_label){
+            max_label = label;
         }
     }
     map_cluster_groups[method] = max_label + 1;
@@ -295,22 +427,21 @@ void Widget::on_button_variance_clicked()
 
     int selectedColumn = ui->tableView->currentIndex().column();
 
-    if (model->horizontalHeaderItem(selectedColumn)->text() == "id"){
+    if (dataset.name(selectedColumn) == "id"){
         QMessageBox::critical(this, "Error", "Please do not select id column.");
         return;
     }
 
     if (selectedColumn >= 0){
-        Eigen::VectorXd columnData(model->rowCount());
-
-        for (int row = 0; row < model->rowCount(); row++){
-            QModelIndex index = model->index(row, selectedColumn);
-            QVariant data = model->data(index);
-            columnData[row] = data.toDouble();
+//        读取加载时统计的结果，不再扫描数据
+        const Column_Profile &profile = dataset.profile(selectedColumn);
+        if (!profile.valid){
+            QMessageBox::critical(this, "Error", "Please select a numeric column.");
+            return;
         }
 
-        double mean = columnData.mean();
-        double variance = (columnData.array() - mean).array().square().mean();
+        double mean = profile.moments.mean;
+        double variance = profile.moments.variance();
 
         QDialog window(this);
 //        window.setAttribute(Qt::WA_DeleteOnClose);
@@ -324,6 +455,14 @@ void Widget::on_button_variance_clicked()
         layout.addWidget(&label_variance);
         QLineEdit edit_variance(QString::number(variance), &window);
         layout.addWidget(&edit_variance);
+        QLabel label_nulls("空值数", &window);
+        layout.addWidget(&label_nulls);
+        QLineEdit edit_nulls(QString::number(profile.null_count), &window);
+        layout.addWidget(&edit_nulls);
+        QLabel label_distinct("不同取值数（估计）", &window);
+        layout.addWidget(&label_distinct);
+        QLineEdit edit_distinct(QString::number(profile.distinct, 'f', 0), &window);
+        layout.addWidget(&edit_distinct);
         window.exec();
     }
 }
@@ -343,28 +482,66 @@ void Widget::on_button_barchart_clicked()
         return;
     }
 
-    if (model->horizontalHeaderItem(selectedColumns[0].column())->text() == "id"){
+    if (dataset.name(selectedColumns[0].column()) == "id"){
         QMessageBox::critical(this, "Error", "Please do not select id column.");
         return;
     }
 
-    const size_t cnt_total_rows = model->rowCount();
     const size_t col_selected = selectedColumns[0].column();
-    QList<float> columnData;
+    const Column_Profile &profile = dataset.profile(col_selected);
+    if (!profile.valid){
+        QMessageBox::critical(this, "Error", "Please select a numeric column.");
+        return;
+    }
+//    全为空值的列没有取值范围
+    if (profile.moments.count == 0){
+        QMessageBox::critical(this, "Error", "The column has no values.");
+        return;
+    }
     bool is_discrete = false;
-    if (model->horizontalHeaderItem(col_selected)->text() == "diagnosis"){
+    if (dataset.name(col_selected) == "diagnosis"){
         is_discrete = true;
     }
-    for (size_t row = 0; row < cnt_total_rows; row ++){
-        auto index = model->index(row, col_selected);
-        columnData.append(model->data(index).toFloat());
-    }
 
-    //    打开新窗口
-    auto window_bar = new Window_Barchart(is_discrete, columnData, this);
+    //    打开新窗口，直方图和正态分布参数都来自加载时的统计
+    auto window_bar = new Window_Barchart(is_discrete, profile, this);
     window_bar->show();
 }
 
+/**
+ * @brief 箱线图按钮的槽函数。中位数、四分位数等来自加载时构造的分位数sketch。
+ * 
+ */
+void Widget::on_button_boxplot_clicked()
+{
+    auto selectedColumns = ui->tableView->selectionModel()->selectedColumns();
+
+    if (selectedColumns.size() != 1) {
+        QMessageBox::critical(this, "Error", "Please select only 1 column.");
+        return;
+    }
+
+    const size_t col_selected = selectedColumns[0].column();
+    if (dataset.name(col_selected) == "id"){
+        QMessageBox::critical(this, "Error", "Please do not select id column.");
+        return;
+    }
+
+    const Column_Profile &profile = dataset.profile(col_selected);
+    if (!profile.valid){
+        QMessageBox::critical(this, "Error", "Please select a numeric column.");
+        return;
+    }
+//    全为空值的列没有取值范围
+    if (profile.moments.count == 0){
+        QMessageBox::critical(this, "Error", "The column has no values.");
+        return;
+    }
+
+    auto window_box = new Window_Boxplot(QString::fromStdString(dataset.name(col_selected)), profile, this);
+    window_box->show();
+}
+
 /**
  * @brief 散点图按钮的槽函数。
  * 
@@ -395,14 +572,12 @@ void Widget::on_button_scatter_clicked()
         return;
     }
 
-    if (model->horizontalHeaderItem(colX)->text() == "id" ||
-        model->horizontalHeaderItem(colY)->text() == "id") {
+    if (dataset.name(colX) == "id" || dataset.name(colY) == "id") {
         QMessageBox::critical(this, "Error", "Please do not select id column.");
         return;
     }
 
-    if (model->horizontalHeaderItem(colX)->text() == "diagnosis" ||
-        model->horizontalHeaderItem(colY)->text() == "diagnosis") {
+    if (dataset.name(colX) == "diagnosis" || dataset.name(colY) == "diagnosis") {
         QMessageBox::critical(this, "Error", "Please do not select diagnosis column.");
         return;
     }
@@ -411,25 +586,20 @@ void Widget::on_button_scatter_clicked()
     const QString headerX = header->model()->headerData(colX, Qt::Horizontal).toString();
     const QString headerY = header->model()->headerData(colY, Qt::Horizontal).toString();
 
-    auto get_data = [&](const int col){
-        for (int row = 0; row < model->rowCount(); row++){
-            QModelIndex index = model->index(row, col);
-            QVariant data = model->data(index);
-
-            bool conversionOk;
-            float value = data.toFloat(&conversionOk);
-            if (conversionOk) {
-                if (index.column() == colX) {
-                    dataX.push_back(value);
-                } else if (index.column() == colY) {
-                    dataY.push_back(value);
-                }
-            }
-        }
+//    跳过任一列为空值的行
+    const Column &columnX = dataset.column(colX);
+    const Column &columnY = dataset.column(colY);
+    auto is_null = [](const Column &column, size_t row){
+        return column.type == Column_type::float32 ? std::isnan(column.floats[row])
+                                                   : column.ints[row] == Dataset::null_int;
     };
-
-    get_data(colX);
-    get_data(colY);
+    for (size_t row = 0; row < dataset.row_count(); row ++){
+        if (is_null(columnX, row) || is_null(columnY, row)){
+            continue;
+        }
+        dataX.push_back(dataset.value(row, colX));
+        dataY.push_back(dataset.value(row, colY));
+    }
 
 //    打开新窗口
     auto window_scatter = new Window_Scatter(dataX, dataY, headerX, headerY, this);
@@ -472,38 +642,22 @@ void Widget::on_button_covariance_clicked()
         return;
     }
 
-    const size_t cnt_col = selectedColumns.count();
-    const size_t cnt_row = model->rowCount();
-
     QStringList headers_selected;
+    std::vector<size_t> cols;
     // 获取选中列的表头项并添加到header_selected
     for (QModelIndex index : selectedColumns) {
         int col = index.column();
-        if (model->horizontalHeaderItem(col)->text() == "id"){
+        if (dataset.name(col) == "id"){
             QMessageBox::critical(this, "Error", "Please do not select id column.");
             return;
         }
-        auto headerItem = model->horizontalHeaderItem(col);
-        if (headerItem) {
-            headers_selected.append(headerItem->text());
-        }
+        headers_selected.append(QString::fromStdString(dataset.name(col)));
+        cols.push_back(col);
     }
 
-    std::vector<std::vector<float>> cells(cnt_col, std::vector<float>(cnt_row));
-    for (size_t i = 0; i < cnt_col; i ++){
-        for (size_t row = 0; row < cnt_row; row ++){
-            size_t col = selectedColumns[i].column();
-            QModelIndex index = model->index(row, col);
-            if (i < cells.size() && row < cells[0].size()) {
-                cells[i][row] = model->data(index).toFloat();
-            }
-            else{
-                QMessageBox::critical(this, "Error", "index out of range");
-            }
-        }
-    }
+    const Dataset_View samples = dataset.select(cols);
 
-    auto window_covar = new Window_Covariance(cells, headers_selected, this);
+    auto window_covar = new Window_Covariance(samples.matrix(), headers_selected, this);
     window_covar->show();
 //    connect(window_covar, &QObject::destroyed, this, &Widget::delete_obj);
 }
@@ -525,33 +679,15 @@ void Widget::on_button_pca_clicked()
         return;
     }
 
-    const size_t cnt_col = selectedColumns.count();
-    const size_t cnt_row = model->rowCount();
-
-    std::vector<std::vector<float>> samples;
-    for (size_t row = 0; row < cnt_row; row ++){
-        std::vector<float> variants;
-        for (size_t i = 0; i < cnt_col; i ++){
-            size_t col = selectedColumns[i].column();
-            if (model->horizontalHeaderItem(col)->text() == "id"){
-                QMessageBox::critical(this, "Error", "Please do not select id column.");
-                return;
-            }
-            QModelIndex index = model->index(row, col);
-//            cells[row][i] = model->data(index).toFloat();
-            variants.push_back(model->data(index).toFloat());
-        }
-        samples.push_back(std::move(variants));
+    auto samples = samples_selected(2);
+    if (samples.empty()){
+        return;
     }
 
 //    BM信息
-    std::vector<int> diagnosis;
-    for (size_t row = 0; row < cnt_row; row ++) {
-        QModelIndex index = model->index(row, col_diagnosis_at);
-        diagnosis.push_back(model->data(index).toInt());
-    }
+    std::vector<int> diagnosis = dataset.int_column(col_diagnosis_at);
 
-    auto widget_pca = new Window_PCA(this, std::move(samples), std::move(diagnosis), this);
+    auto widget_pca = new Window_PCA(this, samples.release(), std::move(diagnosis), this);
     widget_pca->show();
 //    connect(widget_pca, &QObject::destroyed, this, &Widget::delete_obj);
 }
@@ -567,20 +703,123 @@ void Widget::on_button_cluster_clicked()
 }
 
 /**
- * @brief K-means聚类按钮的槽函数。
+ * @brief K-means聚类按钮的槽函数。聚类在后台线程中运行，完成后写入表格。
  * 
  */
 void Widget::on_cluster_kmeans_clicked(){
+    if (!table_ready()){
+        return;
+    }
     auto samples = samples_selected(1);
     if (samples.empty()){
         return;
     }
 
-    Eigen::MatrixXf centers;
-    std::vector<int> labels;
-    std::tie(centers, labels) = clusterKMeans(samples, map_cluster_groups[Cluster_method::kmeans], kmeans_maxiter);
+    KMeansOptions options;
+    options.k = map_cluster_groups[Cluster_method::kmeans];
+    options.maxIter = kmeans_maxiter;
+    options.nInit = kmeans_ninit;
+    options.seed = kmeans_seed;
+    options.threads = kmeans_threads;
+
+    auto task = new Cluster_Task(Cluster_method::kmeans, samples.release(), this);
+    task->kmeans_options = options;
+    start_cluster_task(task);
+}
+
+/**
+ * @brief 在后台运行聚类任务，并显示可取消的进度对话框。已有任务在运行时先取消它。
+ *
+ * @param task 尚未启动的任务，由Widget持有
+ */
+void Widget::start_cluster_task(Cluster_Task *task){
+    stop_cluster_task();
+    cluster_task = task;
+
+    cluster_progress = new QProgressDialog("Clustering...", "Cancel", 0, 0, this);
+    cluster_progress->setWindowTitle(map_method_string[task->method()]);
+    cluster_progress->setMinimumDuration(300);
+    cluster_progress->setAutoReset(false);
+    cluster_progress->setAutoClose(false);
+    connect(cluster_progress, &QProgressDialog::canceled, task, &QThread::requestInterruption);
+
+    connect(task, &Cluster_Task::progress, this, &Widget::show_cluster_progress);
+    connect(task, &Cluster_Task::preview_ready, this, &Widget::show_cluster_preview);
+    connect(task, &QThread::finished, this, &Widget::finish_cluster_task);
+    task->start();
+}
+
+/**
+ * @brief 取消正在运行的聚类任务并等待其结束，不应用其结果。
+ *
+ */
+void Widget::stop_cluster_task(){
+    if (!cluster_task){
+        return;
+    }
+    cluster_task->requestInterruption();
+    cluster_task->wait();
+    cluster_task->deleteLater();
+    cluster_task = nullptr;
+    cluster_progress->deleteLater();
+    cluster_progress = nullptr;
+}
+
+void Widget::show_cluster_progress(int done, int total, const QString &text){
+    if (!cluster_task || sender() != cluster_task){
+        return;
+    }
+    cluster_progress->setMaximum(total);
+    cluster_progress->setValue(std::min(done, total));
+    cluster_progress->setLabelText(text);
+}
+
+/**
+ * @brief 转发聚类运行中的分组预览，打开的降维图可据此实时更新。
+ *
+ */
+void Widget::show_cluster_preview(){
+    if (!cluster_task || sender() != cluster_task){
+        return;
+    }
+    std::vector<int> labels = cluster_task->take_preview();
+    if (labels.size() == dataset.row_count()){
+        emit cluster_preview(cluster_task->method(), labels);
+    }
+}
+
+/**
+ * @brief 聚类任务结束后的处理。正常完成时将分组写入表格，出错时提示错误信息。
+ *
+ */
+void Widget::finish_cluster_task(){
+    if (!cluster_task || sender() != cluster_task){
+        return;
+    }
+    Cluster_Task *task = cluster_task;
+    cluster_task = nullptr;
+    task->deleteLater();
+    cluster_progress->deleteLater();
+    cluster_progress = nullptr;
+
+    if (!task->succeeded()){
+        if (!task->error_message().isEmpty()){
+            QMessageBox::critical(this, "Error", task->error_message());
+        }
+        return;
+    }
 
-    add_cluster(Cluster_method::kmeans, labels);
+    const Cluster_method method = task->method();
+    std::vector<int> labels = task->take_labels();
+//    任务运行期间表格可能已被替换或正在重新加载
+    if (loader || profile_task || labels.size() != dataset.row_count()){
+        return;
+    }
+    add_cluster(method, labels);
+    emit cluster_preview(method, labels);
+    if (method != Cluster_method::dbscan){
+        emit kmeans_finished(method, task->iterations(), task->inertia(), task->converged());
+    }
 }
 
 /**
@@ -607,13 +846,7 @@ void Widget::on_coloring_kmeans_clicked(){
  * 
  */
 void Widget::on_decoloring_clicked(){
-    const size_t cnt_total_rows = model->rowCount();
-    const size_t cnt_total_cols = model->columnCount();
-    for (size_t row = 0; row < cnt_total_rows; row ++){
-        for (size_t col = 0; col < cnt_total_cols; col ++){
-            model->item(row, col)->setBackground(QBrush(Qt::white));
-        }
-    }
+    model->clear_row_colors();
 }
 
 /**
@@ -621,12 +854,19 @@ void Widget::on_decoloring_clicked(){
  * 
  */
 void Widget::on_cluster_dbscan_clicked(){
+    if (!table_ready()){
+        return;
+    }
     auto samples = samples_selected(1);
+    if (samples.empty()){
+        return;
+    }
 
     qDebug() << dbscan_epsilon << dbscan_minPts;
-    auto labels = dbscan(samples, dbscan_epsilon, dbscan_minPts);
-
-    add_cluster(Cluster_method::dbscan, labels);
+    auto task = new Cluster_Task(Cluster_method::dbscan, samples.release(), this);
+    task->dbscan_epsilon = dbscan_epsilon;
+    task->dbscan_minPts = dbscan_minPts;
+    start_cluster_task(task);
 }
 
 /**
@@ -637,6 +877,40 @@ void Widget::on_coloring_dbscan_clicked(){
     coloring_method(Cluster_method::dbscan);
 }
 
+/**
+ * @brief Mini-batch K-means聚类按钮的槽函数。每步只用一小批随机样本更新中心，适合行数很多时。
+ * 
+ */
+void Widget::on_cluster_minibatch_clicked(){
+    if (!table_ready()){
+        return;
+    }
+    auto samples = samples_selected(1);
+    if (samples.empty()){
+        return;
+    }
+
+    KMeansOptions options;
+    options.k = map_cluster_groups[Cluster_method::minibatch];
+    options.maxIter = minibatch_maxiter;
+    options.batchSize = minibatch_size;
+    options.nInit = kmeans_ninit;
+    options.seed = kmeans_seed;
+    options.threads = kmeans_threads;
+
+    auto task = new Cluster_Task(Cluster_method::minibatch, samples.release(), this);
+    task->kmeans_options = options;
+    start_cluster_task(task);
+}
+
+/**
+ * @brief 根据Mini-batch K-means分组结果进行着色。
+ * 
+ */
+void Widget::on_coloring_minibatch_clicked(){
+    coloring_method(Cluster_method::minibatch);
+}
+
 /**
  * @brief 机器学习按钮的槽函数。
  * 
@@ -644,49 +918,26 @@ void Widget::on_coloring_dbscan_clicked(){
 void Widget::on_button_ml_clicked()
 {
     // 获取症状数据
-    std::vector<int> diagnosis;
-    size_t col_diagnosis = 0;
-    for (size_t col = 0; col < model->columnCount(); col ++){
-        if (model->horizontalHeaderItem(col)->text() == "diagnosis"){
-            col_diagnosis = col;
-            break;
-        }
-    }
-    for (size_t row = 0; row < model->rowCount(); row ++){
-        auto index = model->index(row, col_diagnosis);
-        diagnosis.push_back(model->data(index).toInt());
+    int col_diagnosis = dataset.index_of("diagnosis");
+    if (col_diagnosis < 0){
+        col_diagnosis = 0;
     }
+    std::vector<int> diagnosis = dataset.int_column(col_diagnosis);
 
-    // 获取特征数据
-    std::vector<std::vector<float>> samples;
-    for (size_t row = 0; row < model->rowCount(); row ++){
-        std::vector<float> variants;
-        for (size_t col = 0; col < model->columnCount(); col ++){
-            if (col == col_diagnosis){
-                continue;
-            }
-            if (model->horizontalHeaderItem(col)->text() == "id"){
-                continue;
-            }
-            auto index = model->index(row, col);
-            variants.push_back(model->data(index).toFloat());
-        }
-        samples.push_back(std::move(variants));
-    }
-
-    // 获取特征名称
+    // 获取特征所在列和特征名称
+    std::vector<size_t> cols_feature;
     std::vector<std::string> feature_names;
-    // std::vector<QString> feature_names;
-    for (size_t col = 0; col < model->columnCount(); col ++){
-        if (model->horizontalHeaderItem(col)->text() == "id"){
-            continue;
-        }
-        if (model->horizontalHeaderItem(col)->text() == "diagnosis"){
+    for (size_t col = 0; col < dataset.column_count(); col ++){
+        if (dataset.name(col) == "id" || dataset.name(col) == "diagnosis"){
             continue;
         }
-        feature_names.push_back(model->horizontalHeaderItem(col)->text().toStdString());
+        cols_feature.push_back(col);
+        feature_names.push_back(dataset.name(col));
     }
 
+    // 获取特征数据
+    Eigen::MatrixXf samples = dataset.select(cols_feature).release();
+
     auto window_ml = new Window_ML(std::move(diagnosis), std::move(feature_names), std::move(samples));
     window_ml->show();
 }
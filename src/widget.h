@@ -2,20 +2,22 @@
 #define WIDGET_H
 
 #include <QWidget>
-#include <QStandardItem>
 #include <QTableView>
 #include <QMainWindow>
 #include <QtCharts/QChart>
 
+#include "dataset_model.h"
+#include "include/cluster_task.h"
+
+class Dataset_Loader;
+class Profile_Task;
+class Cache_Writer;
+class QProgressDialog;
+
 QT_BEGIN_NAMESPACE
 namespace Ui { class Widget; }
 QT_END_NAMESPACE
 
-enum class Cluster_method{
-    kmeans,
-    dbscan
-};
-
 class Widget : public QWidget
 {
     Q_OBJECT
@@ -26,14 +28,24 @@ public:
 
     // 聚类方法到设定的聚类数的映射
     std::map<Cluster_method, int> map_cluster_groups{{Cluster_method::kmeans, 4},
-                                                     {Cluster_method::dbscan, 8}};
+                                                     {Cluster_method::dbscan, 8},
+                                                     {Cluster_method::minibatch, 4}};
 
     // 聚类方法到设定的聚类颜色的映射
     std::map<Cluster_method, int> map_cluster_col{{Cluster_method::kmeans, 10},
-                                                     {Cluster_method::dbscan, 11}};
+                                                     {Cluster_method::dbscan, 11},
+                                                     {Cluster_method::minibatch, 12}};
 
     // K-means聚类的最大迭代次数
     int kmeans_maxiter = 100;
+    // K-means用不同初始中心重复运行的次数，以及随机数种子
+    int kmeans_ninit = 4;
+    unsigned int kmeans_seed = 0;
+    // K-means使用的线程数，0表示全部硬件线程。结果与线程数无关
+    int kmeans_threads = 0;
+    // Mini-batch K-means每步抽取的样本数和最多的步数
+    int minibatch_size = 1024;
+    int minibatch_maxiter = 300;
     // dbscan聚类的参数
     float dbscan_epsilon = 15;
     int dbscan_minPts = 3;
@@ -50,11 +62,24 @@ public:
 
     void on_coloring_dbscan_clicked();
 
+    void on_cluster_minibatch_clicked();
+
+    void on_coloring_minibatch_clicked();
+
+signals:
+    // 聚类运行中的分组预览，以及完成后的最终分组
+    void cluster_preview(Cluster_method method, const std::vector<int> &labels);
+
+    // K-means或Mini-batch K-means结束时发出，报告实际迭代次数、最终的惯性以及是否在最大迭代次数内收敛
+    void kmeans_finished(Cluster_method method, int iterations, double inertia, bool converged);
+
 private slots:
     void on_button_variance_clicked();
 
     void on_button_barchart_clicked();
 
+    void on_button_boxplot_clicked();
+
     void on_button_scatter_clicked();
 
     void on_button_open_clicked();
@@ -69,6 +94,24 @@ private slots:
 
     void on_button_ml_clicked();
 
+    void on_button_cancel_clicked();
+
+    void append_loaded_rows();
+
+    void show_loading_progress(qint64 bytes_done, qint64 bytes_total, qint64 rows, double seconds);
+
+    void finish_loading();
+
+    void finish_profiling();
+
+    void finish_cache_writer();
+
+    void show_cluster_progress(int done, int total, const QString &text);
+
+    void show_cluster_preview();
+
+    void finish_cluster_task();
+
 private:
     // 诊断结果所在列
     int col_diagnosis_at = 1;
@@ -78,23 +121,59 @@ private:
     // 数据表的路径
     QString path_table = ":/resource/breast-cancer.csv";
 
-    // 数据表模型
-    QStandardItemModel *model{new QStandardItemModel(this)};
+    // 数据表，持有全部数据
+    Dataset dataset;
+
+    // 数据表模型，仅用于显示
+    Dataset_Model *model{new Dataset_Model(&dataset, this)};
 
 //    tableView set in ui file
 //    QTableView *view{new QTableView(this)};
 
+    // 后台加载线程，加载结束后为nullptr
+    Dataset_Loader *loader{nullptr};
+
+    // 后台统计各列的线程，统计结束后为nullptr
+    Profile_Task *profile_task{nullptr};
+
+    // 后台写缓存的线程，写完后为nullptr
+    Cache_Writer *cache_writer{nullptr};
+
+    // 后台聚类任务及其进度对话框，同一时间只运行一个
+    Cluster_Task *cluster_task{nullptr};
+    QProgressDialog *cluster_progress{nullptr};
+
     // 数据表图表
     QChart* chart{new QChart};
 
     void open_table();
 
+    void stop_loading();
+
+    void start_profiling();
+
+    void stop_profiling();
+
+    void stop_cache_writer();
+
+    void start_cluster_task(Cluster_Task *task);
+
+    void stop_cluster_task();
+
+    void set_analysis_enabled(bool enabled);
+
+    void set_loading_visible(bool visible);
+
+    void update_col_diagnosis();
+
     void delete_obj(QObject *obj);
 
+    bool table_ready();
+
     void add_cluster(Cluster_method method, std::vector<int> labels);
 
     void coloring_method(Cluster_method method);
 
-    std::vector<std::vector<float>> samples_selected(size_t least_cols = 1);
+    Dataset_View samples_selected(size_t least_cols = 1);
 };
 #endif // WIDGET_H
@@ -5,16 +5,17 @@
 #include <QBarSet>
 #include <QValueAxis>
 #include <QBarCategoryAxis>
+#include <QLabel>
 
 /**
  * @brief Construct a new Window_Barchart::Window_Barchart object
  * 
- * @param is_discrete 选取列的数值是否离散。若离散则采取不同的直方图分组策略，且不绘制正态分布密度曲线。
- * @param columnData 列的数据。
+ * @param is_discrete 选取列的数值是否离散。若离散则固定分为两组，且不绘制正态分布密度曲线。
+ * @param profile 列的概要统计，直方图由其中的细分直方图合并得到。
  * @param parent 
  */
-Window_Barchart::Window_Barchart(bool is_discrete, const QList<float> &columnData, Widget *parent)
-    : QMainWindow(parent)
+Window_Barchart::Window_Barchart(bool is_discrete, const Column_Profile &profile, Widget *parent)
+    : QMainWindow(parent), profile(profile), is_discrete(is_discrete)
 {
     setAttribute(Qt::WA_DeleteOnClose);
 //    布局
@@ -40,6 +41,30 @@ Window_Barchart::Window_Barchart(bool is_discrete, const QList<float> &columnDat
     connect(check_linechart, &QCheckBox::stateChanged,
             this, &Window_Barchart::on_check_line);
 
+//    分组规则，顺序与BinRule一致
+//    Freedman-Diaconis用四分位距估计组宽，对偏态和有极端值的列更合适，作为默认
+    combo_rule->addItem("Sturges", static_cast<int>(BinRule::sturges));
+    combo_rule->addItem("Scott", static_cast<int>(BinRule::scott));
+    combo_rule->addItem("Freedman-Diaconis", static_cast<int>(BinRule::freedmanDiaconis));
+    combo_rule->addItem("指定组数", static_cast<int>(BinRule::fixed));
+    combo_rule->setCurrentIndex(2);
+    spin_bins->setRange(1, histogramMaxBins);
+    spin_bins->setValue(8);
+    spin_bins->setEnabled(false);
+    layout_checkbox->addStretch();
+    layout_checkbox->addWidget(new QLabel("分组：", this));
+    layout_checkbox->addWidget(combo_rule);
+    layout_checkbox->addWidget(spin_bins);
+
+//    离散列固定分为两组
+    combo_rule->setEnabled(!is_discrete);
+
+    connect(combo_rule, &QComboBox::currentIndexChanged, this, [this](){
+        spin_bins->setEnabled(static_cast<BinRule>(combo_rule->currentData().toInt()) == BinRule::fixed);
+        update_bins();
+    });
+    connect(spin_bins, &QSpinBox::valueChanged, this, &Window_Barchart::update_bins);
+
 //    绘图
 
 //    绘制频次直方图
@@ -47,66 +72,20 @@ Window_Barchart::Window_Barchart(bool is_discrete, const QList<float> &columnDat
     layout_main->addWidget(chartView);
     chartView->setMinimumSize(1200, 600);
 
-//    将数据等距分成8组
-//    区分离散
-    const int cnt_set = is_discrete ? 2 : 8;
-    const float minValue = is_discrete ? 0 : *std::min_element(columnData.begin(), columnData.end());
-    const float maxValue = is_discrete ? 1 : *std::max_element(columnData.begin(), columnData.end());
-    const float binWidth = (maxValue - minValue) / cnt_set;
-
-//    统计每个组的频次
-    QVector<int> frequencies(cnt_set, 0);
-    if (is_discrete) {
-        for (float value : columnData) {
-            int ivalue = static_cast<int>(value);
-            frequencies[ivalue]++;
-        }
-    }
-    else{
-        for (float value : columnData) {
-            int bin = static_cast<int>((value - minValue) / binWidth);
-            if (bin >= 0 && bin < frequencies.size()) {
-                frequencies[bin]++;
-            }
-        }
-    }
-
+//    均值、方差和最值与方差按钮的结果一致
+    const Moments &moments = profile.moments;
+    const float minValue = is_discrete ? 0 : moments.min;
+    const float maxValue = is_discrete ? 1 : moments.max;
 
 //    直方图添加到图中
     chart->addSeries(barSeries);
-    auto barSet = new QBarSet("Bar", this);
 
-//    将频次添加到直方图中
-    for (int i = 0; i < frequencies.size(); ++i) {
-        *barSet << frequencies[i];
-    }
-    barSeries->append(barSet);
-
-//    创建横轴
-//    区分离散
-    auto axisX = new QBarCategoryAxis(this);
+//    创建横轴和纵轴，刻度在update_bins中设置
     axisX->setTitleText("Range");
-    if (is_discrete){
-        axisX->append("Benign");
-        axisX->append("Malignant");
-    }
-    else{
-        for (int i = 0; i < frequencies.size(); ++i) {
-            axisX->append(
-                QString::asprintf("%.*g", 4, i * binWidth + minValue) +
-                "-" +
-                QString::asprintf("%.*g", 4, (i + 1) * binWidth + minValue)
-            );
-        }
-    }
     chart->addAxis(axisX, Qt::AlignBottom);
     barSeries->attachAxis(axisX);
 
-//    创建纵轴
-//    区分离散
-    auto axisY = new QValueAxis(this);
     axisY->setTitleText("Frequency");
-    axisY->setRange(0, columnData.size());
     chart->addAxis(axisY, Qt::AlignLeft);
     barSeries->attachAxis(axisY);
 
@@ -116,39 +95,12 @@ Window_Barchart::Window_Barchart(bool is_discrete, const QList<float> &columnDat
     lineSeries->setName("Line");
     chart->addSeries(lineSeries);
 
-//    添加数据点，连接直方图的顶部
-//    区分离散
-
 //    计算正态分布参数
 
-//    样本均值
-    float mean = 0;
-    float sum = 0;
-    for (auto i : columnData){
-        sum += i;
-    }
-    mean = sum / columnData.size();
-
-//    样本方差
-    float stddev = 0;
-    float sum_squared = 0;
-    for (auto i : columnData){
-        sum_squared += pow(i - mean, 2);
-    }
-    stddev = sqrt(sum_squared / static_cast<float>(columnData.size()));
-
-//    在最小到最大的范围内，等距离取6个点曲线，并添加到lineSeries上面
-    auto pdf_normal = [mean, stddev](float x)->float{
-        return 1.0 / (stddev * sqrt(2 * 3.1415)) * exp(-1 / (2 * pow(stddev, 2)) * pow(x - mean, 2));
-    };
-    if (!is_discrete){
-        for (int i = 0; i < 9; i ++){
-            float x = minValue + i * binWidth;
-            float y = pdf_normal(x);
-            lineSeries->append(x, y);
-        }
-    }
-    const float max_density = pdf_normal(mean);
+//    样本均值和标准差（方差除以n - 1）
+    const float mean = moments.mean;
+    const float stddev = moments.stddev();
+    const float max_density = 1.0 / (stddev * sqrt(2 * 3.1415));
 
 //    将分布曲线与坐标轴关联
 //    横轴范围：最小到最大值
@@ -164,11 +116,76 @@ Window_Barchart::Window_Barchart(bool is_discrete, const QList<float> &columnDat
     lineSeries->attachAxis(axisX_dist);
     lineSeries->attachAxis(axisY_dist);
 
+    update_bins();
+
 //      勾选设置可见
     check_barchart->setChecked(true);
     check_linechart->setChecked(true);
 }
 
+/**
+ * @brief 按选择的规则重新分组，更新直方图、横轴刻度和密度曲线。
+ * 
+ * 组的频次由列概要中的细分直方图合并得到，不读取原始数据，切换规则和组数不需要等待。
+ */
+void Window_Barchart::update_bins(){
+    const Moments &moments = profile.moments;
+    const BinRule rule = is_discrete ? BinRule::fixed : static_cast<BinRule>(combo_rule->currentData().toInt());
+    const Histogram histogram = profile.binned(rule, is_discrete ? 2 : spin_bins->value());
+
+//    离散列只有一种取值时，全部样本都在该取值对应的组
+    std::vector<long long> frequencies = histogram.counts;
+    if (is_discrete && moments.min == moments.max) {
+        frequencies.assign(2, 0);
+        int ivalue = static_cast<int>(moments.min);
+        if (ivalue >= 0 && ivalue < static_cast<int>(frequencies.size())) {
+            frequencies[ivalue] = moments.count;
+        }
+    }
+
+//    将频次添加到直方图中
+    barSeries->clear();
+    auto barSet = new QBarSet("Bar", this);
+    long long max_frequency = 0;
+    for (long long frequency : frequencies) {
+        *barSet << frequency;
+        max_frequency = std::max(max_frequency, frequency);
+    }
+    barSeries->append(barSet);
+
+//    横轴刻度
+//    区分离散
+    axisX->clear();
+    if (is_discrete){
+        axisX->append("Benign");
+        axisX->append("Malignant");
+    }
+    else{
+        for (size_t i = 0; i + 1 < histogram.edges.size(); ++i) {
+            axisX->append(
+                QString::asprintf("%.*g", 4, histogram.edges[i]) +
+                "-" +
+                QString::asprintf("%.*g", 4, histogram.edges[i + 1])
+            );
+        }
+    }
+    axisY->setRange(0, std::max<long long>(1, max_frequency * 1.1));
+
+//    在组的边界上取点绘制正态分布密度曲线
+//    离散列不绘制
+    lineSeries->clear();
+    const float mean = moments.mean;
+    const float stddev = moments.stddev();
+    auto pdf_normal = [mean, stddev](float x)->float{
+        return 1.0 / (stddev * sqrt(2 * 3.1415)) * exp(-1 / (2 * pow(stddev, 2)) * pow(x - mean, 2));
+    };
+    if (!is_discrete){
+        for (double x : histogram.edges){
+            lineSeries->append(x, pdf_normal(x));
+        }
+    }
+}
+
 /**
  * @brief 选择显示直方图。
  * 
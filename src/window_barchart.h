@@ -8,13 +8,17 @@
 #include <QBarSeries>
 #include <QLineSeries>
 #include <QSplineSeries>
+#include <QBarCategoryAxis>
+#include <QValueAxis>
+#include <QComboBox>
+#include <QSpinBox>
 
 class Window_Barchart : public QMainWindow
 {
     Q_OBJECT
 public:
 //    explicit Window_Barchart(Widget *parent = nullptr);
-    explicit Window_Barchart(bool is_discrete, const QList<float> &data, Widget *parent = nullptr);
+    explicit Window_Barchart(bool is_discrete, const Column_Profile &profile, Widget *parent = nullptr);
 //    explicit Window_Barchart(QWidget *parent = nullptr);
 
 signals:
@@ -27,6 +31,19 @@ private:
 //    QLineSeries *lineSeries{new QLineSeries()};
     QSplineSeries *lineSeries{new QSplineSeries()};
 
+    QBarCategoryAxis *axisX{new QBarCategoryAxis(this)};
+    QValueAxis *axisY{new QValueAxis(this)};
+
+//    分组规则和用户指定的组数
+    QComboBox *combo_rule{new QComboBox(this)};
+    QSpinBox *spin_bins{new QSpinBox(this)};
+
+//    切换分组时由其中的细分直方图重新合并，不再读取数据
+    const Column_Profile profile;
+    const bool is_discrete;
+
+    void update_bins();
+
     void on_check_bar(int state);
 
     void on_check_line(int state);
@@ -0,0 +1,82 @@
+#include "window_boxplot.h"
+
+#include <QBoxLayout>
+#include <QFormLayout>
+#include <QLabel>
+#include <QBoxSet>
+#include <QValueAxis>
+#include <QBarCategoryAxis>
+
+/**
+ * @brief Construct a new Window_Boxplot::Window_Boxplot object
+ * 
+ * @param name 列名，作为横轴上箱体的名称。
+ * @param profile 列的概要统计。分位数由其中的KLL sketch估计，不再扫描数据。
+ * @param parent 
+ */
+Window_Boxplot::Window_Boxplot(const QString &name, const Column_Profile &profile, Widget *parent)
+    : QMainWindow(parent)
+{
+    setAttribute(Qt::WA_DeleteOnClose);
+//    布局
+
+    auto central = new QWidget();
+    setCentralWidget(central);
+
+    auto layout_main = new QHBoxLayout(central);
+    central->setLayout(layout_main);
+
+    layout_main->addWidget(chartView, 1);
+    chartView->setMinimumSize(600, 600);
+
+    auto layout_values = new QFormLayout();
+    layout_main->addLayout(layout_values);
+
+//    估计分位数
+//    箱体为四分位数，须为1%和99%分位数，不受极端值影响
+
+    const KllSketch &sketch = profile.quantiles;
+    if (sketch.empty()){
+        layout_values->addRow(new QLabel("No values."));
+        return;
+    }
+    const std::vector<float> q = sketch.quantiles({0, 0.01, 0.25, 0.5, 0.75, 0.99, 1});
+    const float min = q[0], p1 = q[1], q1 = q[2], median = q[3], q3 = q[4], p99 = q[5], max = q[6];
+
+    auto box = new QBoxSet(p1, q1, median, q3, p99, name);
+    boxSeries->append(box);
+    boxSeries->setName(name);
+    chart->addSeries(boxSeries);
+    chart->legend()->hide();
+
+    auto axisX = new QBarCategoryAxis(this);
+    axisX->append(name);
+    chart->addAxis(axisX, Qt::AlignBottom);
+    boxSeries->attachAxis(axisX);
+
+//    纵轴范围：1%到99%分位数，两端留出空白
+    auto axisY = new QValueAxis(this);
+    axisY->setTitleText("value");
+    const float margin = std::max(0.05f * (p99 - p1), 1e-6f);
+    axisY->setRange(p1 - margin, p99 + margin);
+    chart->addAxis(axisY, Qt::AlignLeft);
+    boxSeries->attachAxis(axisY);
+
+//    数值列表
+
+    auto add_value = [=](const QString &label, double value){
+        layout_values->addRow(label, new QLabel(QString::number(value, 'g', 6)));
+    };
+    add_value("最小值", min);
+    add_value("1%分位数", p1);
+    add_value("下四分位数", q1);
+    add_value("中位数", median);
+    add_value("上四分位数", q3);
+    add_value("99%分位数", p99);
+    add_value("最大值", max);
+    add_value("四分位距", q3 - q1);
+    layout_values->addRow("样本数", new QLabel(QString::number(sketch.count())));
+    layout_values->addRow("空值数", new QLabel(QString::number(profile.null_count)));
+    layout_values->addRow("", new QLabel(QString("分位数为估计值，秩误差不超过%1%")
+                                             .arg(100 * sketch.rankError(), 0, 'f', 1)));
+}
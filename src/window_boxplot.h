@@ -0,0 +1,25 @@
+#ifndef WINDOW_BOXPLOT_H
+#define WINDOW_BOXPLOT_H
+
+#include "widget.h"
+
+#include <QMainWindow>
+#include <QChartView>
+#include <QBoxPlotSeries>
+
+class Window_Boxplot : public QMainWindow
+{
+    Q_OBJECT
+public:
+    explicit Window_Boxplot(const QString &name, const Column_Profile &profile, Widget *parent = nullptr);
+
+signals:
+
+private:
+    QChart *chart{new QChart};
+    QChartView *chartView{new QChartView(chart)};
+
+    QBoxPlotSeries *boxSeries{new QBoxPlotSeries()};
+};
+
+#endif // WINDOW_BOXPLOT_H
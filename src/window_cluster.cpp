@@ -49,9 +49,46 @@ Window_Cluster::Window_Cluster(Widget *_table_widget, QWidget *parent):
     edit_kmeans_iter->setText("100");
     connect(edit_kmeans_iter, &QLineEdit::textEdited, this, &Window_Cluster::on_kmeans_iter_edited);
 
+    auto label_kmeans_ninit = new QLabel("Restarts");
+    auto edit_kmeans_ninit = new QLineEdit;
+    layout_kmeans->addRow(label_kmeans_ninit, edit_kmeans_ninit);
+    auto valid_ninit = new QIntValidator(1, 1000, this);
+    edit_kmeans_ninit->setValidator(valid_ninit);
+    edit_kmeans_ninit->setText(QString::number(table_widget->kmeans_ninit));
+    connect(edit_kmeans_ninit, &QLineEdit::textEdited, this, &Window_Cluster::on_kmeans_ninit_edited);
+
+    auto label_kmeans_seed = new QLabel("Seed");
+    auto edit_kmeans_seed = new QLineEdit;
+    layout_kmeans->addRow(label_kmeans_seed, edit_kmeans_seed);
+    auto valid_seed = new QIntValidator(0, INT_MAX, this);
+    edit_kmeans_seed->setValidator(valid_seed);
+    edit_kmeans_seed->setText(QString::number(table_widget->kmeans_seed));
+    connect(edit_kmeans_seed, &QLineEdit::textEdited, this, &Window_Cluster::on_kmeans_seed_edited);
+
+    auto label_kmeans_threads = new QLabel("Threads");
+    auto edit_kmeans_threads = new QLineEdit;
+    layout_kmeans->addRow(label_kmeans_threads, edit_kmeans_threads);
+    auto valid_threads = new QIntValidator(0, 1024, this);
+    edit_kmeans_threads->setValidator(valid_threads);
+    edit_kmeans_threads->setText(QString::number(table_widget->kmeans_threads));
+    edit_kmeans_threads->setToolTip("0 uses all hardware threads");
+    connect(edit_kmeans_threads, &QLineEdit::textEdited, this, &Window_Cluster::on_kmeans_threads_edited);
+
     auto button_kmeans = new QPushButton("start K-means");
     layout_kmeans_button->addWidget(button_kmeans);
 
+    auto label_kmeans_result = new QLabel;
+    layout_kmeans_button->addWidget(label_kmeans_result);
+    connect(table_widget, &Widget::kmeans_finished, label_kmeans_result, [=](Cluster_method method, int iterations, double inertia, bool converged){
+        if (method != Cluster_method::kmeans){
+            return;
+        }
+        label_kmeans_result->setText(QString("%1 iterations%2\ninertia %3")
+                                         .arg(iterations)
+                                         .arg(converged ? ", converged" : ", not converged")
+                                         .arg(inertia, 0, 'g', 6));
+    });
+
     auto box_dbscan = new QGroupBox("dbscan method");
     layout_main->addWidget(box_dbscan);
 
@@ -80,8 +117,57 @@ Window_Cluster::Window_Cluster(Widget *_table_widget, QWidget *parent):
     auto button_dbscan = new QPushButton("start dbscan");
     layout_dbscan_main->addWidget(button_dbscan);
 
+    auto box_minibatch = new QGroupBox("Mini-batch K-means method");
+    layout_main->addWidget(box_minibatch);
+
+    auto layout_minibatch_main = new QVBoxLayout;
+    box_minibatch->setLayout(layout_minibatch_main);
+
+    auto layout_minibatch = new QFormLayout;
+    layout_minibatch_main->addLayout(layout_minibatch);
+
+    auto label_minibatch_k = new QLabel("K");
+    auto edit_minibatch_k = new QLineEdit;
+    layout_minibatch->addRow(label_minibatch_k, edit_minibatch_k);
+    auto valid_minibatch_k = new QIntValidator(1, INT_MAX, this);
+    edit_minibatch_k->setValidator(valid_minibatch_k);
+    edit_minibatch_k->setText(QString::number(table_widget->map_cluster_groups[Cluster_method::minibatch]));
+    connect(edit_minibatch_k, &QLineEdit::textEdited, this, &Window_Cluster::on_minibatch_k_edited);
+
+    auto label_minibatch_size = new QLabel("Batch size");
+    auto edit_minibatch_size = new QLineEdit;
+    layout_minibatch->addRow(label_minibatch_size, edit_minibatch_size);
+    auto valid_minibatch_size = new QIntValidator(1, INT_MAX, this);
+    edit_minibatch_size->setValidator(valid_minibatch_size);
+    edit_minibatch_size->setText(QString::number(table_widget->minibatch_size));
+    connect(edit_minibatch_size, &QLineEdit::textEdited, this, &Window_Cluster::on_minibatch_size_edited);
+
+    auto label_minibatch_iter = new QLabel("Steps");
+    auto edit_minibatch_iter = new QLineEdit;
+    layout_minibatch->addRow(label_minibatch_iter, edit_minibatch_iter);
+    auto valid_minibatch_iter = new QIntValidator(1, INT_MAX, this);
+    edit_minibatch_iter->setValidator(valid_minibatch_iter);
+    edit_minibatch_iter->setText(QString::number(table_widget->minibatch_maxiter));
+    connect(edit_minibatch_iter, &QLineEdit::textEdited, this, &Window_Cluster::on_minibatch_iter_edited);
+
+    auto button_minibatch = new QPushButton("start Mini-batch K-means");
+    layout_minibatch_main->addWidget(button_minibatch);
+
+    auto label_minibatch_result = new QLabel;
+    layout_minibatch_main->addWidget(label_minibatch_result);
+    connect(table_widget, &Widget::kmeans_finished, label_minibatch_result, [=](Cluster_method method, int iterations, double inertia, bool converged){
+        if (method != Cluster_method::minibatch){
+            return;
+        }
+        label_minibatch_result->setText(QString("%1 steps%2\ninertia %3")
+                                            .arg(iterations)
+                                            .arg(converged ? ", converged" : ", not converged")
+                                            .arg(inertia, 0, 'g', 6));
+    });
+
     connect(button_kmeans, &QPushButton::clicked, table_widget, &Widget::on_cluster_kmeans_clicked);
     connect(button_dbscan, &QPushButton::clicked, table_widget, &Widget::on_cluster_dbscan_clicked);
+    connect(button_minibatch, &QPushButton::clicked, table_widget, &Widget::on_cluster_minibatch_clicked);
 }
 
 /**
@@ -113,6 +199,10 @@ Window_Coloring::Window_Coloring(Widget *table_widget, QWidget *parent):
     auto button_dbscan = new QPushButton("dbscan coloring");
     layout_main->addWidget(button_dbscan);
     connect(button_dbscan, &QPushButton::clicked, table_widget, &Widget::on_coloring_dbscan_clicked);
+
+    auto button_minibatch = new QPushButton("Mini-batch K-means coloring");
+    layout_main->addWidget(button_minibatch);
+    connect(button_minibatch, &QPushButton::clicked, table_widget, &Widget::on_coloring_minibatch_clicked);
 }
 
 void Window_Cluster::on_kmeans_k_edited(const QString &text){
@@ -123,6 +213,18 @@ void Window_Cluster::on_kmeans_iter_edited(const QString &text){
     table_widget->kmeans_maxiter = text.toInt();
 }
 
+void Window_Cluster::on_kmeans_ninit_edited(const QString &text){
+    table_widget->kmeans_ninit = std::max(1, text.toInt());
+}
+
+void Window_Cluster::on_kmeans_seed_edited(const QString &text){
+    table_widget->kmeans_seed = text.toUInt();
+}
+
+void Window_Cluster::on_kmeans_threads_edited(const QString &text){
+    table_widget->kmeans_threads = std::max(0, text.toInt());
+}
+
 void Window_Cluster::on_epsilon_edited(const QString &text){
     table_widget->dbscan_epsilon = text.toFloat();
 }
@@ -130,3 +232,15 @@ void Window_Cluster::on_epsilon_edited(const QString &text){
 void Window_Cluster::on_minPts_edited(const QString &text){
     table_widget->dbscan_minPts = text.toInt();
 }
+
+void Window_Cluster::on_minibatch_k_edited(const QString &text){
+    table_widget->map_cluster_groups[Cluster_method::minibatch] = text.toInt();
+}
+
+void Window_Cluster::on_minibatch_size_edited(const QString &text){
+    table_widget->minibatch_size = std::max(1, text.toInt());
+}
+
+void Window_Cluster::on_minibatch_iter_edited(const QString &text){
+    table_widget->minibatch_maxiter = std::max(1, text.toInt());
+}
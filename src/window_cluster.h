@@ -17,10 +17,22 @@ public:
 
     void on_kmeans_iter_edited(const QString &text);
 
+    void on_kmeans_ninit_edited(const QString &text);
+
+    void on_kmeans_seed_edited(const QString &text);
+
+    void on_kmeans_threads_edited(const QString &text);
+
     void on_epsilon_edited(const QString &text);
 
     void on_minPts_edited(const QString &text);
 
+    void on_minibatch_k_edited(const QString &text);
+
+    void on_minibatch_size_edited(const QString &text);
+
+    void on_minibatch_iter_edited(const QString &text);
+
 signals:
 
 };
@@ -10,12 +10,12 @@
 /**
  * @brief Construct a new Window_Covariance::Window_Covariance object
  * 
- * @param variants 变量的数据。
+ * @param samples 变量的数据，每列为一个变量。
  * @param headers 变量的名称。
  * @param parent 
  */
 Window_Covariance::Window_Covariance(
-    const std::vector<std::vector<float>> &variants,
+    const Eigen::Ref<const Eigen::MatrixXf> &samples,
     const QStringList &headers,
     QWidget *parent):
     QMainWindow(parent)
@@ -50,7 +50,7 @@ Window_Covariance::Window_Covariance(
     auto colorBar = new ColorBarWidget(central);
     layout_main->addWidget(colorBar);
 
-    const Eigen::MatrixXf eigen_cov = getCovariance(variants);
+    const Eigen::MatrixXf eigen_cov = getCovariance(samples);
 
     matrixSize = eigen_cov.rows();
 
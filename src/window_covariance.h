@@ -4,13 +4,14 @@
 #include <QMainWindow>
 #include <QTableWidget>
 #include <QPainter>
+#include <Eigen/Dense>
 
 class Window_Covariance : public QMainWindow
 {
     Q_OBJECT
 public:
 //    explicit Window_Covariance(QWidget *parent = nullptr);
-    explicit Window_Covariance(const std::vector<std::vector<float>> &variants,
+    explicit Window_Covariance(const Eigen::Ref<const Eigen::MatrixXf> &samples,
                                const QStringList &headers,
                                QWidget *parent = nullptr);
 
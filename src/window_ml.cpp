@@ -29,19 +29,19 @@
  * 
  * @param _diagnosis 样本的症状列表。0为良性，1为恶性。用于训练标签。
  * @param _feature_names 样本的特征名称列表。
- * @param _samples 样本的特征值列表。
+ * @param _samples 样本的特征值，每行为一个样本。
  * @param parent 
  */
 Window_ML::Window_ML(
     std::vector<int> &&_diagnosis,
     std::vector<std::string> &&_feature_names,
-    std::vector<std::vector<float>> &&_samples,
+    Eigen::MatrixXf &&_samples,
     QWidget *parent):
 
     QMainWindow{parent},
     diagnosis(_diagnosis),
     feature_names(_feature_names),
-    samples(_samples)
+    samples(std::move(_samples))
 {
     // 布局
 
@@ -204,12 +204,12 @@ void Window_ML::on_button_ratio_clicked()
  * @brief 训练按钮的槽函数。根据训练集进行训练，并预测已划分的数据集。
  */
 void Window_ML::on_button_train_clicked(){
-    if (samples.empty() || samples[0].empty()){
+    if (samples.rows() == 0 || samples.cols() == 0){
         QMessageBox::critical(this, "错误", "样本为空");
         return;
     }
-    const int size_features = samples[0].size();
-    const int size_samples = samples.size();
+    const int size_features = samples.cols();
+    const int size_samples = samples.rows();
     const int size_train_samples = idx_train.size();
     const int size_test_samples = idx_test.size();
     const int size_diagnosis = diagnosis.size();
@@ -226,7 +226,7 @@ void Window_ML::on_button_train_clicked(){
     float train[size_train_samples][size_features];
     for (int i = 0; i < size_train_samples; i ++){
         for (int j = 0; j < size_features; j ++){
-            train[i][j] = samples[idx_train[i]][j];
+            train[i][j] = samples(idx_train[i], j);
         }
     }
 
@@ -307,7 +307,7 @@ void Window_ML::on_button_train_clicked(){
     float test[size_test_samples][size_features];
     for (int i = 0; i < size_test_samples; i ++){
         for (int j = 0; j < size_features; j ++){
-            test[i][j] = samples[idx_test[i]][j];
+            test[i][j] = samples(idx_test[i], j);
         }
     }
     DMatrixHandle dtest;
@@ -5,6 +5,7 @@
 #include <QComboBox>
 #include <QTableWidget>
 #include <QLineEdit>
+#include <Eigen/Dense>
 
 class Window_ML : public QMainWindow
 {
@@ -13,7 +14,7 @@ public:
     explicit Window_ML(
         std::vector<int> &&_diagnosis,
         std::vector<std::string> &&_feature_names,
-        std::vector<std::vector<float>> &&_samples,
+        Eigen::MatrixXf &&_samples,
         QWidget *parent = nullptr);
 
 signals:
@@ -21,7 +22,7 @@ signals:
 private:
     const std::vector<int> diagnosis;
     const std::vector<std::string> feature_names;
-    const std::vector<std::vector<float>> samples;
+    const Eigen::MatrixXf samples;
 
     std::vector<int> idx_train;
     std::vector<int> idx_test;
@@ -1,5 +1,4 @@
 #include "window_pca.h"
-#include "include/needed_algo/pca.hpp"
 #include "include/common_utils.h"
 
 #include <QChart>
@@ -17,13 +16,13 @@
 /**
  * @brief Construct a new Window_PCA2D::Window_PCA2D object
  * 
- * @param variants 变量的数据。
+ * @param scores 样本在主成分上的投影，每行为一个样本，只使用前两列。
  * @param labels 每个样本的组别。
  * @param cnt_groups 组别的总数。
  * @param parent 
  */
 Window_PCA2D::Window_PCA2D(
-    const std::vector<std::vector<float>> &variants,
+    const Eigen::Ref<const Eigen::MatrixXf> &scores,
     const std::vector<int> &labels, // size: 2
     const size_t cnt_groups, // 2
     QWidget *parent):
@@ -33,7 +32,7 @@ Window_PCA2D::Window_PCA2D(
     setAttribute(Qt::WA_DeleteOnClose);
     setMinimumSize(800, 600);
 
-    if (variants.size() <= 0){
+    if (scores.cols() < 2){
         QMessageBox::critical(this, "Error", "No variant selected.");
         return;
     }
@@ -72,65 +71,29 @@ Window_PCA2D::Window_PCA2D(
     edit_2nd = new QLineEdit;
     group_2nd->layout()->addWidget(edit_2nd);
 
-    auto chart = new QChart;
+    chart = new QChart;
     auto chartView = new QChartView(chart);
     chartView->setRenderHint(QPainter::Antialiasing);
     layout_main->addWidget(chartView);
 
 //    获取二维视图
-    Eigen::MatrixXf samples_dim2 = pca(variants, 2);
-    const size_t cnt_samples = samples_dim2.rows();
+    samples_dim2 = scores.leftCols(2);
 
 //    创建点集
-    std::vector<QScatterSeries*> vec_series;
-    auto signal_mapper = new QSignalMapper(this);
+    signal_mapper = new QSignalMapper(this);
     for (size_t i = 0; i < cnt_groups; i ++){
-        vec_series.push_back(new QScatterSeries);
-        beautify_scatter_series(vec_series[i]);
-        vec_series[i]->setName("Group " + QString::number(i));
-
-        int r = QRandomGenerator::global()->bounded(20, 241);
-        int g = QRandomGenerator::global()->bounded(20, 241);
-        int b = QRandomGenerator::global()->bounded(20, 241);
-        vec_series[i]->setColor(QColor(r, g, b));
-        connect(vec_series[i], &QScatterSeries::hovered,
-            signal_mapper, static_cast<void (QSignalMapper::*)()>(&QSignalMapper::map));
-        signal_mapper->setMapping(vec_series[i], i);
-        connect(vec_series[i], &QScatterSeries::hovered,
-            this, &Window_PCA2D::onPointHovered);
+        add_group_series();
     }
     connect(signal_mapper, static_cast<void (QSignalMapper::*)(int)>(&QSignalMapper::mappedInt),
         this, &Window_PCA2D::on_group_hovered);
 
 //    添加噪音点集（标签值为-1）
-    auto series_noise = new QScatterSeries;
+    series_noise = new QScatterSeries;
     beautify_scatter_series(series_noise);
     series_noise->setName("Noise");
     series_noise->setColor(QColor(0, 0, 0));
 
-//    填充点集
-    map_xy_col.clear();
-    // map_point_col.clear();
-    for (size_t i = 0; i < cnt_samples; i ++){
-        int label = labels[i];
-        if (label >= 0){
-            vec_series[label]->append(samples_dim2(i, 0), samples_dim2(i, 1));
-            std::string str = std::to_string(samples_dim2(i, 0)) + "," + std::to_string(samples_dim2(i, 1));
-            map_xy_col.insert(std::make_pair(str, i));
-        }
-        else if (label == -1){
-            series_noise->append(samples_dim2(i, 0), samples_dim2(i, 1));
-            std::string str = std::to_string(samples_dim2(i, 0)) + "," + std::to_string(samples_dim2(i, 1));
-            map_xy_col.insert(std::make_pair(str, -1));
-        }
-    }
-
-    for (size_t i = 0; i < cnt_groups; i ++){
-        chart->addSeries(vec_series[i]);
-    }
-    if (series_noise->count() != 0){
-        chart->addSeries(series_noise);
-    }
+    set_labels(labels, cnt_groups);
 
     // for (int i = 0; i < cnt_groups; i ++){
     //     const auto &series = dynamic_cast<QScatterSeries*>(chart->series()[i]);
@@ -148,17 +111,90 @@ Window_PCA2D::Window_PCA2D(
     axisY->setTitleText("2nd Component");
 }
 
+/**
+ * @brief 新建一个组的点集并加入图中。
+ * 
+ */
+void Window_PCA2D::add_group_series(){
+    const size_t i = vec_series.size();
+    auto series = new QScatterSeries;
+    vec_series.push_back(series);
+    beautify_scatter_series(series);
+    series->setName("Group " + QString::number(i));
+
+    int r = QRandomGenerator::global()->bounded(20, 241);
+    int g = QRandomGenerator::global()->bounded(20, 241);
+    int b = QRandomGenerator::global()->bounded(20, 241);
+    series->setColor(QColor(r, g, b));
+    connect(series, &QScatterSeries::hovered,
+        signal_mapper, static_cast<void (QSignalMapper::*)()>(&QSignalMapper::map));
+    signal_mapper->setMapping(series, i);
+    connect(series, &QScatterSeries::hovered,
+        this, &Window_PCA2D::onPointHovered);
+
+    chart->addSeries(series);
+//    坐标轴创建之后加入的点集需要关联到已有的坐标轴
+    for (auto axis : chart->axes()){
+        series->attachAxis(axis);
+    }
+}
+
+/**
+ * @brief 按新的分组重新填充各组的点。聚类运行中每次收到预览时调用，图表实时更新。
+ * 
+ * @param labels 每个样本的组别，-1为噪声。
+ * @param cnt_groups 组别的总数。
+ */
+void Window_PCA2D::set_labels(const std::vector<int> &labels, size_t cnt_groups){
+    if (!chart || labels.size() != size_t(samples_dim2.rows())){
+        return;
+    }
+    while (vec_series.size() < cnt_groups){
+        add_group_series();
+    }
+
+//    填充点集
+    std::vector<QList<QPointF>> group_points(vec_series.size());
+    QList<QPointF> noise_points;
+    map_xy_col.clear();
+    // map_point_col.clear();
+    for (size_t i = 0; i < labels.size(); i ++){
+        int label = labels[i];
+        QPointF point(samples_dim2(i, 0), samples_dim2(i, 1));
+        std::string str = std::to_string(samples_dim2(i, 0)) + "," + std::to_string(samples_dim2(i, 1));
+        if (label >= 0 && size_t(label) < group_points.size()){
+            group_points[label].append(point);
+            map_xy_col.insert(std::make_pair(str, i));
+        }
+        else if (label == -1){
+            noise_points.append(point);
+            map_xy_col.insert(std::make_pair(str, -1));
+        }
+    }
+
+    for (size_t i = 0; i < vec_series.size(); i ++){
+        vec_series[i]->replace(group_points[i]);
+    }
+    series_noise->replace(noise_points);
+    if (series_noise->count() != 0 && !chart->series().contains(series_noise)){
+        chart->addSeries(series_noise);
+        for (auto axis : chart->axes()){
+            series_noise->attachAxis(axis);
+        }
+    }
+}
+
 /**
  * @brief Construct a new Window_PCA3D::Window_PCA3D object
  * 
  * @param edits 组别、坐标等详细信息的显示框。因为需要在选中3D点时修改。
- * @param variants 变量的数据。
+ * @param scores 样本在主成分上的投影，每行为一个样本，只使用前三列。
  * @param labels 每个样本的组别。
  * @param cnt_groups 组别的总数。
  */
 Window_PCA3D::Window_PCA3D(
     std::vector<QLineEdit*> &edits,
-    const std::vector<std::vector<float>> &variants,
+    const Eigen::Ref<const Eigen::MatrixXf> &scores,
     const std::vector<int> &labels,
     const size_t cnt_groups){
 
@@ -206,7 +242,7 @@ Window_PCA3D::Window_PCA3D(
     noise_series->setName("Noise");
     noise_series->setBaseColor(Qt::black);
 
-    Eigen::MatrixXf samples_3d = pca(variants, 3);
+    const auto samples_3d = scores.leftCols(3);
     const size_t cnt_samples = samples_3d.rows(); // 5
 
     std::vector<QScatterDataArray> vec_array;
@@ -247,18 +283,18 @@ Window_PCA3D::Window_PCA3D(
  * @brief Construct a new Window_PCA::Window_PCA object
  * 
  * @param _table_widget 表格的指针。因为需要获取聚类的标签。
- * @param _variants 变量的数据。
+ * @param _variants 变量的数据，每行为一个样本。
  * @param _diagnosis 每个样本的诊断结果。
  * @param parent 
  */
 Window_PCA::Window_PCA(
     Widget *_table_widget,
-    std::vector<std::vector<float>> &&_variants,
+    Eigen::MatrixXf &&_variants,
     std::vector<int> &&_diagnosis,
     QWidget *parent):
     QMainWindow(parent),
     table_widget(_table_widget),
-    variants(_variants),
+    variants(std::move(_variants)),
     diagnosis(_diagnosis){
 
     setAttribute(Qt::WA_DeleteOnClose);
@@ -291,6 +327,11 @@ Window_PCA::Window_PCA(
     group_cluster->addButton(radio_dbscan);
     connect(radio_dbscan, &QRadioButton::toggled, this, &Window_PCA::on_radio_dbscan_toggled);
 
+    auto radio_minibatch = new QRadioButton("Mini-batch K-means");
+    layout_cluster->addWidget(radio_minibatch);
+    group_cluster->addButton(radio_minibatch);
+    connect(radio_minibatch, &QRadioButton::toggled, this, &Window_PCA::on_radio_minibatch_toggled);
+
     auto layout_chart = new QVBoxLayout(box_chart);
 
     button_2d = new QPushButton("2D 降维（仅标记BM）");
@@ -308,18 +349,31 @@ Window_PCA::Window_PCA(
     connect(button_3d_cluster, &QPushButton::clicked, this, &Window_PCA::on_button_3dcluster_clicked);
 }
 
+/**
+ * @brief 返回前三个主成分的分解结果。只在第一次调用时计算，之后的2D、3D视图都使用同一结果。
+ * 
+ * @return const PcaResult& 
+ */
+const PcaResult &Window_PCA::pca_result(){
+    if (!decomposed){
+        decomposition = pcaDecompose(variants, 3);
+        decomposed = true;
+    }
+    return decomposition;
+}
+
 /**
  * @brief 2D降维按钮的槽函数。仅标记BM。
  * 
  */
 void Window_PCA::on_button_2d_clicked(){
-    if (variants[0].size() < 2) {
+    if (variants.cols() < 2) {
         QMessageBox::critical(this, "Error", "Please select more than 2 columns.");
         return;
     }
 
     auto window_2d = new QMainWindow(this);
-    auto widget_2d = new Window_PCA2D(variants, diagnosis, 2, window_2d);
+    auto widget_2d = new Window_PCA2D(pca_result().scores, diagnosis, 2, window_2d);
     window_2d->setCentralWidget(widget_2d);
     window_2d->show();
 }
@@ -345,12 +399,23 @@ void Window_PCA::on_radio_dbscan_toggled(bool checked){
     }
 }
 
+/**
+ * @brief 显示Mini-batch K-means聚类算法的分组。
+ * 
+ * @param checked 
+ */
+void Window_PCA::on_radio_minibatch_toggled(bool checked){
+    if (checked){
+        cluster_method = Cluster_method::minibatch;
+    }
+}
+
 /**
  * @brief 3D降维按钮的槽函数。仅标记BM。
  * 
  */
 void Window_PCA::on_button_3d_clicked(){
-    if (variants[0].size() < 3){
+    if (variants.cols() < 3){
         QMessageBox::critical(this, "Error", "Please select more than 3 columns.");
         return;
     }
@@ -406,7 +471,7 @@ void Window_PCA::on_button_3d_clicked(){
 
     auto edits_bm = set_layout(layout_bm);
 
-    auto scatter_bm = new Window_PCA3D(edits_bm, variants, diagnosis, 2);
+    auto scatter_bm = new Window_PCA3D(edits_bm, pca_result().scores, diagnosis, 2);
 
     auto container_bm = QWidget::createWindowContainer(scatter_bm);
     container_bm->setMinimumSize(600, 600);
@@ -419,12 +484,12 @@ void Window_PCA::on_button_3d_clicked(){
  * 
  */
 void Window_PCA::on_button_2dcluster_clicked(){
-    if (variants[0].size() < 2) {
+    if (variants.cols() < 2) {
         QMessageBox::critical(this, "Error", "Please select more than 2 columns.");
         return;
     }
 
-    auto widget_bm = new Window_PCA2D(variants, diagnosis, 2);
+    auto widget_bm = new Window_PCA2D(pca_result().scores, diagnosis, 2);
 
 //    获取该聚类的标签
     std::vector<int> labels = table_widget->get_labels_of(cluster_method);
@@ -437,7 +502,20 @@ void Window_PCA::on_button_2dcluster_clicked(){
         return;
     }
 
-    auto widget_cluster = new Window_PCA2D(variants, labels, cnt_groups);
+    auto widget_cluster = new Window_PCA2D(pca_result().scores, labels, cnt_groups);
+//    同一方法再次聚类时，随运行中的预览实时更新
+    const Cluster_method method = cluster_method;
+    connect(table_widget, &Widget::cluster_preview, widget_cluster,
+        [widget_cluster, method](Cluster_method preview_method, const std::vector<int> &preview_labels){
+        if (preview_method != method){
+            return;
+        }
+        int max_label = -1;
+        for (int label : preview_labels){
+            max_label = std::max(max_label, label);
+        }
+        widget_cluster->set_labels(preview_labels, max_label + 1);
+    });
 
     auto window = new QMainWindow;
     auto central = new QWidget(window);
@@ -457,7 +535,7 @@ void Window_PCA::on_button_2dcluster_clicked(){
  * 
  */
 void Window_PCA::on_button_3dcluster_clicked(){
-    if (variants[0].size() < 3) {
+    if (variants.cols() < 3) {
         QMessageBox::critical(this, "Error", "Please select more than 3 columns.");
         return;
     }
@@ -521,8 +599,8 @@ void Window_PCA::on_button_3dcluster_clicked(){
     auto edits_bm = set_layout(layout_bm);
     auto edits_cluster = set_layout(layout_cluster);
 
-    auto scatter_bm = new Window_PCA3D(edits_bm, variants, diagnosis, 2);
-    auto scatter_cluster = new Window_PCA3D(edits_cluster, variants, labels, cnt_groups);
+    auto scatter_bm = new Window_PCA3D(edits_bm, pca_result().scores, diagnosis, 2);
+    auto scatter_cluster = new Window_PCA3D(edits_cluster, pca_result().scores, labels, cnt_groups);
 
     auto container_bm = QWidget::createWindowContainer(scatter_bm);
     container_bm->setMinimumSize(600, 600);
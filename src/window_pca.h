@@ -7,6 +7,8 @@
 #include <QMainWindow>
 #include <QChart>
 #include <QChartView>
+#include <QScatterSeries>
+#include <QSignalMapper>
 #include <QLabel>
 #include <QPushButton>
 #include <QDialog>
@@ -15,23 +17,35 @@
 #include <QLineEdit>
 #include <QVector3D>
 #include <QPointF>
+#include <Eigen/Dense>
+
+#include "include/needed_algo/pca.hpp"
 
 class Window_PCA2D : public QWidget
 {
     Q_OBJECT
 public:
     explicit Window_PCA2D(
-        const std::vector<std::vector<float>> &variants,
+        const Eigen::Ref<const Eigen::MatrixXf> &scores,
         const std::vector<int> &labels,
         const size_t cnt_groups,
         QWidget *parent = nullptr);
 
+    void set_labels(const std::vector<int> &labels, size_t cnt_groups);
 
 signals:
 
 private:
     int dim_reduced = 2;
 
+    // 降维后的坐标，每行为一个样本
+    Eigen::MatrixXf samples_dim2;
+
+    QChart *chart{nullptr};
+    QSignalMapper *signal_mapper{nullptr};
+    std::vector<QScatterSeries*> vec_series;
+    QScatterSeries *series_noise{nullptr};
+
     QLineEdit *edit_group;
     QLineEdit *edit_col;
     QLineEdit *edit_1st;
@@ -44,6 +58,8 @@ private:
 
     void on_group_hovered(int index);
     void onPointHovered(const QPointF &point, bool state);
+
+    void add_group_series();
 };
 
 class Window_PCA : public QMainWindow{
@@ -51,7 +67,7 @@ class Window_PCA : public QMainWindow{
 public:
     Window_PCA(
         Widget *_table_widget,
-        std::vector<std::vector<float>> &&_variants,
+        Eigen::MatrixXf &&_variants,
         std::vector<int> &&_diagnosis,
         QWidget *parent = nullptr);
 
@@ -66,7 +82,13 @@ private:
 
     Cluster_method cluster_method = Cluster_method::kmeans;
 
-    const std::vector<std::vector<float>> variants;
+    const Eigen::MatrixXf variants;
+
+    // 前三个主成分的分解结果，第一次打开降维图时计算，各视图共用
+    PcaResult decomposition;
+    bool decomposed = false;
+
+    const PcaResult &pca_result();
     const std::vector<int> diagnosis;
 
     QPushButton *button_2d;
@@ -76,6 +98,7 @@ private:
 
     void on_radio_kmeans_toggled(bool checked);
     void on_radio_dbscan_toggled(bool checked);
+    void on_radio_minibatch_toggled(bool checked);
 
     void on_button_2dcluster_clicked();
     void on_button_3dcluster_clicked();
@@ -89,7 +112,7 @@ class Window_PCA3D : public Q3DScatter{
 public:
     explicit Window_PCA3D(
         std::vector<QLineEdit*> &edits,
-        const std::vector<std::vector<float>> &variants,
+        const Eigen::Ref<const Eigen::MatrixXf> &scores,
         const std::vector<int> &labels,
         const size_t cnt_groups);
 